@@ -0,0 +1,105 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "AnsiSgrParser.h"
+
+void AnsiSgrState::reset() {
+    fg = bg = color_default;
+    bold = faint = italic = underline = reverse = strike = false;
+}
+
+/** xterm palette: 6x6x6 color cube, then 24 grays
+ */
+uint AnsiSgrState::xterm256(int index) {
+    static const int level[] = { 0, 95, 135, 175, 215, 255 };
+    if (index >= 232) {
+        int g = 8 + 10 * (index - 232);
+        return (g << 16) | (g << 8) | g;
+    }
+    index -= 16;
+    return (level[index / 36] << 16) | (level[(index / 6) % 6] << 8) | level[index % 6];
+}
+
+void AnsiSgrParser::reset() {
+    mode = Text;
+    nparams = 0;
+    private_csi = false;
+    attr.reset();
+}
+
+/** 38/48 extended color: 5;N (palette) or 2;R;G;B (truecolor)
+ *  advance <i> over consumed parameters
+ */
+int AnsiSgrParser::ext_color(int &i) const {
+    if (i + 2 < nparams && params[i + 1] == 5) {
+        int c = params[i + 2] & 0xFF;
+        i += 2;
+        return c;
+    }
+    if (i + 4 < nparams && params[i + 1] == 2) {
+        int c = AnsiSgrState::rgb_flag |
+                (qMin(params[i + 2], 255) << 16) |
+                (qMin(params[i + 3], 255) << 8) |
+                 qMin(params[i + 4], 255);
+        i += 4;
+        return c;
+    }
+    i = nparams;    // malformed: skip the rest
+    return AnsiSgrState::color_default;
+}
+
+/** map Select Graphic Rendition parameters to attributes
+ */
+void AnsiSgrParser::apply_sgr() {
+    for (int i = 0; i < nparams; ++i) {
+        int p = params[i];
+        switch (p) {
+        case 0:  attr.reset(); break;
+        case 1:  attr.bold = true; break;
+        case 2:  attr.faint = true; break;
+        case 3:  attr.italic = true; break;
+        case 4:
+        case 21: attr.underline = true; break;
+        case 7:  attr.reverse = true; break;
+        case 9:  attr.strike = true; break;
+        case 22: attr.bold = attr.faint = false; break;
+        case 23: attr.italic = false; break;
+        case 24: attr.underline = false; break;
+        case 27: attr.reverse = false; break;
+        case 29: attr.strike = false; break;
+        case 38: attr.fg = ext_color(i); break;
+        case 39: attr.fg = AnsiSgrState::color_default; break;
+        case 48: attr.bg = ext_color(i); break;
+        case 49: attr.bg = AnsiSgrState::color_default; break;
+        default:
+            if (p >= 30 && p <= 37)
+                attr.fg = p - 30;
+            else if (p >= 40 && p <= 47)
+                attr.bg = p - 40;
+            else if (p >= 90 && p <= 97)
+                attr.fg = p - 90 + 8;
+            else if (p >= 100 && p <= 107)
+                attr.bg = p - 100 + 8;
+            // blink, fonts, etc: ignored
+        }
+    }
+}
@@ -0,0 +1,166 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ANSISGRPARSER_H
+#define ANSISGRPARSER_H
+
+#include "pqConsole_global.h"
+#include <QString>
+
+/** text attributes, as accumulated from SGR escape sequences
+ *  colors: -1 default, 0..255 palette index, truecolor when (c & rgb_flag)
+ */
+struct PQCONSOLESHARED_EXPORT AnsiSgrState {
+
+    enum { color_default = -1, rgb_flag = 0x1000000 };
+
+    int fg, bg;
+    bool bold, faint, italic, underline, reverse, strike;
+
+    AnsiSgrState() { reset(); }
+    void reset();
+
+    bool operator==(const AnsiSgrState &s) const {
+        return fg == s.fg && bg == s.bg && bold == s.bold && faint == s.faint &&
+               italic == s.italic && underline == s.underline &&
+               reverse == s.reverse && strike == s.strike;
+    }
+    bool operator!=(const AnsiSgrState &s) const { return !(*this == s); }
+
+    /** RGB of a 256 colors palette entry above the 16 configurable ones */
+    static uint xterm256(int index);
+};
+
+/** incremental decoder of ANSI terminal sequences
+ *  State is kept between calls, so a sequence split between two
+ *  writes is handled. Only SGR (ESC [ ... m) changes attributes,
+ *  other CSI and OSC sequences are consumed and ignored.
+ *  No allocation happens while parsing.
+ */
+class PQCONSOLESHARED_EXPORT AnsiSgrParser {
+public:
+
+    AnsiSgrParser() { reset(); }
+
+    /** forget any partial sequence and attributes */
+    void reset();
+
+    /** current attributes */
+    const AnsiSgrState& state() const { return attr; }
+
+    /** scan <text>, calling span(offset, length) for each text run.
+     *  state() holds the attributes of the run while span is called
+     */
+    template<class Span>
+    void parse(const QString &text, Span span);
+
+private:
+
+    enum { max_params = 32 };
+    enum e_mode { Text, Escape, Csi, Osc, OscEscape } mode;
+
+    int params[max_params];
+    int nparams;
+    bool private_csi;
+
+    AnsiSgrState attr;
+
+    void apply_sgr();
+    int ext_color(int &i) const;
+};
+
+template<class Span>
+void AnsiSgrParser::parse(const QString &text, Span span) {
+    const QChar *t = text.constData();
+    int n = text.length(), start = 0;
+
+    for (int i = 0; i < n; ++i) {
+        ushort ch = t[i].unicode();
+        switch (mode) {
+
+        case Text:
+            if (ch == 0x1B) {
+                if (i > start)
+                    span(start, i - start);
+                mode = Escape;
+            }
+            break;
+
+        case Escape:
+            if (ch == '[') {
+                mode = Csi;
+                params[0] = 0;
+                nparams = 1;
+                private_csi = false;
+            }
+            else if (ch == ']')
+                mode = Osc;
+            else {
+                // two chars sequence: ignored
+                mode = Text;
+                start = i + 1;
+            }
+            break;
+
+        case Csi:
+            if (ch >= '0' && ch <= '9') {
+                int &p = params[nparams - 1];
+                p = qMin(p * 10 + (ch - '0'), 0xFFFF);
+            }
+            else if (ch == ';' || ch == ':') {
+                if (nparams < max_params)
+                    params[nparams++] = 0;
+            }
+            else if (ch >= 0x3C && ch <= 0x3F)
+                private_csi = true;
+            else if (ch >= 0x20 && ch <= 0x2F)
+                ;   // intermediate
+            else {
+                // final byte, or malformed: sequence ends anyway
+                if (ch == 'm' && !private_csi)
+                    apply_sgr();
+                mode = Text;
+                start = i + 1;
+            }
+            break;
+
+        case Osc:
+            if (ch == 0x07) {
+                mode = Text;
+                start = i + 1;
+            }
+            else if (ch == 0x1B)
+                mode = OscEscape;
+            break;
+
+        case OscEscape:
+            mode = ch == '\\' ? Text : Osc;
+            start = i + 1;
+            break;
+        }
+    }
+
+    if (mode == Text && start < n)
+        span(start, n - start);
+}
+
+#endif // ANSISGRPARSER_H
@@ -20,12 +20,22 @@
     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#define PROLOG_MODULE "pqConsole"
 #include "Completion.h"
 #include "PREDICATE.h"
 #include "SwiPrologEngine.h"
+#include "PrologLexer.h"
 #include <QDebug>
+#include <QMutex>
+#include <QSet>
+#include <QDateTime>
 #include <QFile>
 #include <QTextStream>
+#include <QAtomicInt>
+#include <QDir>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QRunnable>
 
 struct Bin : C { Bin(CCP op, T Left, T Right) : C(op, V(Left, Right)) {} };
 struct Uni : C { Uni(CCP op, T arg) : C(op, arg) {} };
@@ -40,25 +50,71 @@ struct arith : Bin { arith(T Pred, T Num) : Bin("/", Pred, Num) {} };
 #define one long(1)
 #define _V T()
 
+/** trailing identifier of <left>, starting lowercase, not quoted
+ *  the lexer tells if it's a token of its own, not inside quoted text or comments
+ */
+QString Completion::word_prefix(QString left) {
+    int s = left.length();
+    while (s > 0 && (left[s - 1].isLetterOrNumber() || left[s - 1] == '_'))
+        --s;
+    if (s == left.length() || !left[s].isLower())
+        return QString();
+
+    int state = 0, line = 0;
+    for (int eol; (eol = left.indexOf('\n', line)) >= 0 && eol < s; line = eol + 1)
+        state = PrologLexer::lex(left.mid(line, eol - line), state, [](int, int, PrologLexer::token) {});
+
+    bool word = false;
+    PrologLexer::lex(left.mid(line), state, [&](int start, int length, PrologLexer::token t) {
+        if (line + start + length == left.length())
+            word = t == PrologLexer::Atom && line + start == s;
+    });
+    return word ? left.mid(s) : QString();
+}
+
 /** context sensitive completion
  *  take current line, give list of completions (both atoms and files)
  *  thanks to Jan for crafting a proper interface wrapping SWI-Prolog available facilities
  */
 QString Completion::initialize(int promptPosition, QTextCursor c, QStringList &strings) {
-    QString rets;
-    SwiPrologEngine::in_thread _int;
-    try {
-        int p = c.position();
-        Q_ASSERT(p >= promptPosition);
+    int p = c.position();
+    Q_ASSERT(p >= promptPosition);
+
+    c.setPosition(promptPosition, c.KeepAnchor);
+    QString before = c.selectedText();
+
+    c.setPosition(p);
+    c.movePosition(c.EndOfLine, c.KeepAnchor);
+    QString after = c.selectedText();
 
-        c.setPosition(promptPosition, c.KeepAnchor);
-        QString left = c.selectedText();
-        if (left.length()) {
-            PlString Before(left.toStdWString().data());
+    return initialize(before, after, strings);
+}
+
+/** text based, the cursor is between <before> and <after>
+ */
+QString Completion::initialize(QString before, QString after, QStringList &strings) {
+
+    // common case: a plain identifier, known to index
+    // predicate and module names come first, then other atoms
+    QString prefix = word_prefix(before);
+    if (!prefix.isEmpty() && index_ready()) {
+        atoms_refresh();
+        QStringList found = words.find(prefix);
+        QSet<QString> seen = found.toSet();
+        foreach (QString a, atoms.find(prefix))
+            if (!seen.contains(a))
+                found.append(a);
+        if (!found.isEmpty()) {
+            strings.append(found);
+            return prefix;
+        }
+    }
 
-            c.setPosition(p);
-            c.movePosition(c.EndOfLine, c.KeepAnchor);
-            QString after = c.selectedText();
+    QString rets;
+    if (before.length()) {
+        SwiPrologEngine::in_thread _int;
+        try {
+            PlString Before(before.toStdWString().data());
             PlString After(after.toStdWString().data());
 
             PlTerm Completions, Delete, word;
@@ -66,132 +122,231 @@ QString Completion::initialize(int promptPosition, QTextCursor c, QStringList &s
                 for (PlTail l(Completions); l.next(word); )
                     strings.append(t2w(word));
 
-            c.setPosition(p);
             rets = t2w(Delete);
         }
-    }
-    catch(PlException e) {
-        qDebug() << t2w(e);
-    }
-    catch(...) {
-        qDebug() << "...";
+        catch(PlException e) {
+            qDebug() << t2w(e);
+        }
+        catch(...) {
+            qDebug() << "...";
+        }
     }
 
     return rets;
 }
 
-//predicate3(setof)
-//structure5(sub_atom)
 query2(module_property)
+query1(current_module)
+query1(current_predicate)
+query1(current_atom)
 structure1(exports)
 
-/** issue a query filling the model storage
- *  this will change when I will learn how to call SWI-Prolog completion interface
+PrefixIndex Completion::words;
+PrefixIndex Completion::indicators;
+PrefixIndex Completion::local;
+PrefixIndex Completion::atoms;
+
+static QAtomicInt index_built, hook_installed;
+static QMutex index_sync;
+
+/** atoms index is stale (a file has been loaded), a scan is running, when last completed */
+static QAtomicInt atoms_dirty(1), atoms_scanning;
+static QAtomicInteger<qint64> atoms_scanned_at;
+
+/** min ms between atoms scans */
+static const qint64 atoms_scan_interval = 2000;
+
+/** load predicates into strings
+ *  from index, built on first use
  */
 void Completion::initialize(QSet<QString> &strings, bool reload) {
-    /*static QSet<QString> preds;*/
-    Q_UNUSED(reload)
-    //static QMap<QString, QSet<QString>> cmods;
-
-    T Mod, Exp, PI;
-    for (module_property mp(Mod, exports(Exp)); mp; ) {
-        for (L exp(Exp); exp.next(PI); )
-            //preds.insert(t2w(exp));
-            strings.insert(t2w(PI));
-    }
-    /*
-    if (curr.isEmpty() || reload) {
-        curr.clear();
-        SwiPrologEngine::in_thread _int;
-        try {
+    if (index_ready(reload))
+        foreach (QString pi, indicators.words())
+            strings.insert(pi);
+}
 
-            PlTerm p,m,a,l,v;
-            PlQuery q("setof",
-                PlTermv(p,
-                    quv(m,
-                        quv(a,
-                            join(PlCompound("current_predicate", mod(m, arith(p, a))),
-                                neg(C("sub_atom", PlTermv(p, zero, one, _V, A("$"))))
-                    ))),
-                l));
-            if (q.next_solution())
-                for (PlTail x(l); x.next(v); )
-                    curr << t2w(v);
-
-            PlTerm M, Ms;
-            if (PlCall("setof", PlTermv(M, PlCompound("current_module", M), Ms)))
-                for (PlTail x(Ms); x.next(M); )
-                    curr << t2w(M);
+/** exports, and for user and system modules all visible predicates
+ */
+void Completion::index_module(QString module) {
+    QStringList lw, lpi;
+    lw << module;
 
+    T Mod = A(module), Exp, PI, N, Ar;
+    for (module_property mp(Mod, exports(Exp)); mp; )
+        for (L exp(Exp); exp.next(PI); ) {
+            lpi << t2w(PI);
+            lw << t2w(PI[1]);
         }
-        catch(PlException e) {
-            qDebug() << t2w(e);
+
+    QStringList ll;
+    if (module == "user" || module == "system")
+        for (current_predicate cp(C(":", V(Mod, C("/", V(N, Ar))))); cp; ) {
+            QString n = t2w(N);
+            if (!n.startsWith('$')) {
+                lw << n;
+                lpi << QString("%1/%2").arg(n).arg(long(Ar));
+                if (module == "user")
+                    ll << n;
+            }
         }
+
+    local.insert(ll);
+    words.insert(lw);
+    indicators.insert(lpi);
+}
+
+/** atoms completed from word_prefix: lowercase start, letters, digits and _ only
+ *  a full scan of the atom table: call from a pooled engine, see atoms_refresh
+ */
+void Completion::index_atoms() {
+    SwiPrologEngine::in_thread _int;
+    try {
+        QStringList la;
+        T Atom;
+        for (current_atom ca(Atom); ca; )
+            if (Atom.type() == PL_ATOM) {
+                QString a = t2w(Atom);
+                bool id = !a.isEmpty() && a[0].isLower();
+                for (int i = 1; id && i < a.length(); ++i)
+                    id = a[i].isLetterOrNumber() || a[i] == '_';
+                if (id)
+                    la << a;
+            }
+        // merged: lookups meanwhile don't see an empty index
+        atoms.insert(la);
+    }
+    catch(PlException e) {
+        qDebug() << t2w(e);
     }
-    strings.unite(curr);
-    */
 }
 
-Completion::status Completion::helpidx_status = Completion::untried;
-Completion::t_pred_docs Completion::pred_docs;
+class atoms_job : public QRunnable {
+public:
+    virtual void run() {
+        Completion::index_atoms();
+        atoms_scanned_at.storeRelease(QDateTime::currentMSecsSinceEpoch());
+        atoms_scanning.storeRelease(0);
+    }
+};
 
-/** initialize and cache all predicates with description
+/** no engine used here: when stale, start a background scan, at most every atoms_scan_interval
  */
-bool Completion::helpidx() {
-    if (helpidx_status == untried) {
-        helpidx_status = missing;
+void Completion::atoms_refresh() {
+    if (!atoms_dirty.loadAcquire())
+        return;
+    if (QDateTime::currentMSecsSinceEpoch() - atoms_scanned_at.loadAcquire() < atoms_scan_interval)
+        return;
+    if (!atoms_scanning.testAndSetOrdered(0, 1))
+        return;
+    atoms_dirty.storeRelease(0);
+    QThreadPool::globalInstance()->start(new atoms_job);
+}
+
+/** pq_completion_index(+Module)
+ *  called from user:message_hook/3 after a file is loaded
+ */
+PREDICATE(pq_completion_index, 1) {
+    if (index_built.loadAcquire()) {
+        Completion::index_module(t2w(PL_A1));
+        atoms_dirty.storeRelease(1);
+    }
+    return TRUE;
+}
+
+/** first call scans all modules, then the hook keeps indexes updated
+ *  building is serialized, callers waiting get the index built meanwhile
+ */
+bool Completion::index_ready(bool reload) {
+    if (index_built.loadAcquire() && !reload)
+        return true;
+
+    QMutexLocker lk(&index_sync);
+    if (index_built.loadAcquire() && !reload)
+        return true;
+
+    SwiPrologEngine::in_thread _int;
+    try {
+        if (hook_installed.testAndSetOrdered(0, 1))
+            PlCall("assertz((user:message_hook(load_file(done(_,_,_,M,_,_)),_,_) :- "
+                   "catch(pqConsole:pq_completion_index(M),_,true), fail))");
+        atoms_dirty.storeRelease(1);
+        words.clear();
+        indicators.clear();
+        local.clear();
+        T M;
+        for (current_module cm(M); cm; )
+            index_module(t2w(M));
+        index_built.storeRelease(1);
+    }
+    catch(PlException e) {
+        qDebug() << t2w(e);
+    }
+    return index_built.loadAcquire();
+}
+
+QAtomicInt Completion::helpidx_status(Completion::untried);
+HelpIndex Completion::pred_docs;
+
+/** map the cached index, building it from library(helpidx) if missing or invalid
+ *  pred_docs is published by helpidx_status, it's not accessed before available
+ */
+class helpidx_job : public QRunnable {
+public:
+    virtual void run() {
+        int status = Completion::missing;
         SwiPrologEngine::in_thread _e;
         try {
-            if (    PlCall("load_files(library(helpidx), [silent(true)])") &&
+            QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+            QDir().mkpath(dir);
+            PlTerm Version;
+            PlCall("current_prolog_flag", V(A("version"), Version));
+            QString path = QString("%1/helpidx-%2.bin").arg(dir).arg(long(Version));
+
+            HelpIndex &docs = Completion::pred_docs;
+            bool ready = docs.open(path);
+            if (    !ready &&
+                    PlCall("load_files(library(helpidx), [silent(true)])") &&
                     PlCall("current_module(help_index)"))
             {
-                {   PlTerm Name, Arity, Descr, Start, Stop;
-                    PlQuery q("help_index", "predicate", V(Name, Arity, Descr, Start, Stop));
-                    while (q.next_solution()) {
-                        long arity = Arity.type() == PL_INTEGER ? long(Arity) : -1;
-                        QString name = t2w(Name);
-                        t_pred_docs::iterator x = pred_docs.find(name);
-                        if (x == pred_docs.end())
-                            x = pred_docs.insert(name, t_decls());
-                        x.value().append(qMakePair(int(arity), t2w(Descr)));
-                    }
+                QList<HelpIndex::entry> rows;
+                PlTerm Name, Arity, Descr, Start, Stop;
+                PlQuery q("help_index", "predicate", V(Name, Arity, Descr, Start, Stop));
+                while (q.next_solution()) {
+                    HelpIndex::entry e = { t2w(Name), Arity.type() == PL_INTEGER ? int(long(Arity)) : -1, t2w(Descr) };
+                    rows.append(e);
                 }
-
-                if (PlCall("load_files(library(console_input), [silent(true)])"))
-                    if (PlCall("current_module(prolog_console_input)"))
-                        helpidx_status = available;
+                ready = HelpIndex::build(path, rows) && docs.open(path);
             }
 
-            /*
-            if (!PlCall("current_module(prolog_console_input)")) {
-                QString ci = "console_input.pl";
-                QFile f(QString(":/%1").arg(ci));
-                if (f.open(f.ReadOnly)) {
-                    QTextStream s(&f);
-                    if (!_e.named_load(ci, s.readAll()))
-                        qDebug() << "can't load" << ci;
-                }
-            }
-            */
+            if (ready && !docs.isEmpty() && PlCall("load_files(library(console_input), [silent(true)])"))
+                if (PlCall("current_module(prolog_console_input)"))
+                    status = Completion::available;
         }
         catch(PlException e) {
             qDebug() << CCP(e);
         }
+        Completion::helpidx_status.storeRelease(status);
     }
+};
 
-    return helpidx_status == available && !pred_docs.isEmpty();
+/** first call starts building in background, GUI isn't blocked
+ */
+bool Completion::helpidx() {
+    if (helpidx_status.testAndSetOrdered(untried, building))
+        QThreadPool::globalInstance()->start(new helpidx_job);
+    return helpidx_available();
 }
 
 /** access/compute predicate description tip from cached
  */
 QString Completion::pred_tip(QTextCursor c) {
-    if (helpidx_status == available) {
+    if (helpidx_available()) {
         c.select(c.WordUnderCursor);
         QString w =  c.selectedText();
-        auto p = pred_docs.constFind(w);
-        if (p != pred_docs.end()) {
+        t_decls p = pred_docs.find(w);
+        if (!p.isEmpty()) {
             QStringList l;
-            foreach(auto x, p.value())
+            foreach(auto x, p)
                 l.append(QString("%1/%2:%3").arg(w).arg(x.first).arg(x.second));
             return l.join("\n");
         }
@@ -24,8 +24,11 @@
 #define COMPLETION_H
 
 #include "pqConsole_global.h"
+#include "PrefixIndex.h"
+#include "HelpIndex.h"
 
 #include <QMap>
+#include <QAtomicInt>
 #include <QCompleter>
 #include <QTextCursor>
 #include <QAbstractItemView>
@@ -37,22 +40,49 @@ struct PQCONSOLESHARED_EXPORT Completion
     /** context sensitive completion */
     static QString initialize(int promptPosition, QTextCursor cursor, QStringList &strings);
 
+    /** context sensitive completion, from text around cursor: usable out of GUI thread */
+    static QString initialize(QString before, QString after, QStringList &strings);
+
     /** load predicates into strings */
     static void initialize(QSet<QString> &strings, bool reload = false);
 
-    /** tooltips display, from helpidx.pl */
-    enum status { untried, available, missing };
-    static status helpidx_status;
+    /** predicate and module names, indicators: built on first use,
+     *  then updated by pq_completion_index/1 when a file is loaded
+     */
+    static PrefixIndex words, indicators;
+
+    /** names defined in user module, i.e. by consulted files */
+    static PrefixIndex local;
+
+    /** atoms that are plain identifiers, scanned in background after files are loaded */
+    static PrefixIndex atoms;
+    static void index_atoms();
+    static void atoms_refresh();
+
+    /** trailing identifier of <left>, starting lowercase, not quoted */
+    static QString word_prefix(QString left);
 
-    /** predicate -> declarations */
+    /** build indexes and install the load hook, if not yet done */
+    static bool index_ready(bool reload = false);
+
+    /** add exports of module to indexes (call in a Prolog thread) */
+    static void index_module(QString module);
+
+    /** tooltips display, from helpidx.pl, state is a status */
+    enum status { untried, building, available, missing };
+    static QAtomicInt helpidx_status;
+
+    /** predicate -> declarations, mapped from a file cached per SWI-Prolog version */
     typedef QPair<int, QString> t_decl;
     typedef QList<t_decl> t_decls;
-    typedef QMap<QString, t_decls> t_pred_docs;
-    static t_pred_docs pred_docs;
+    static HelpIndex pred_docs;
 
-    /** initialize if required, return true if available */
+    /** start initialization on a pooled engine if required, return true if available */
     static bool helpidx();
 
+    /** the index is mapped, pred_docs can be accessed */
+    static bool helpidx_available() { return helpidx_status.loadAcquire() == available; }
+
     /** access/compute predicate description tip from cached */
     static QString pred_tip(QTextCursor c);
 };
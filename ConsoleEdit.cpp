@@ -30,6 +30,9 @@
 #include "pqMainWindow.h"
 #include "pqConsole.h"
 #include "blockSig.h"
+#include "EnginePool.h"
+#include "SemanticColour.h"
+#include "GuiPost.h"
 
 #include <signal.h>
 
@@ -44,8 +47,12 @@
 #include <QTextBlock>
 #include <QMessageBox>
 #include <QMainWindow>
+#include <QTextCodec>
 #include <QApplication>
-#include <QStringListModel>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QPointer>
+#include <QScrollBar>
 
 /** peek color by index */
 static QColor ANSI2col(int c, bool highlight = false) { return Preferences::ANSI2col(c, highlight); }
@@ -64,12 +71,15 @@ ConsoleEdit::ConsoleEdit(int argc, char **argv, QWidget *parent)
     qRegisterMetaType<pfunc>("pfunc");
 
     setup();
+
+    // engines ready for in_thread, created once Prolog is initialized
+    EnginePool::set_capacity(Preferences().engine_pool_size);
+
     eng = new SwiPrologEngine(this);
 
     // wire up console IO
-    connect(eng, SIGNAL(user_output(QString)), this, SLOT(user_output(QString)));
     connect(eng, SIGNAL(user_prompt(int, bool)), this, SLOT(user_prompt(int, bool)));
-    connect(this, SIGNAL(user_input(QString)), eng, SLOT(user_input(QString)));
+    connect(eng, SIGNAL(input_drained()), this, SLOT(input_feed()));
 
     connect(eng, SIGNAL(finished()), this, SLOT(eng_completed()));
 
@@ -84,6 +94,7 @@ void ConsoleEdit::add_thread(int id) {
     Q_ASSERT(id > 0);
     Q_ASSERT(thids.empty());
     thids.append(id);
+    pqConsole::bind_thread(id, this);
 }
 
 /** this start an *interactor* console hosted in a QMainWindow
@@ -121,9 +132,8 @@ void ConsoleEdit::setup(Swipl_IO* io) {
     setup();
 
     // wire up console IO
-    connect(io, SIGNAL(user_output(QString)), this, SLOT(user_output(QString)));
     connect(io, SIGNAL(user_prompt(int, bool)), this, SLOT(user_prompt(int, bool)));
-    connect(this, SIGNAL(user_input(QString)), io, SLOT(user_input(QString)));
+    connect(io, SIGNAL(input_drained()), this, SLOT(input_feed()));
 
     connect(io, SIGNAL(sig_eng_at_exit()), this, SLOT(eng_completed()));
 
@@ -140,6 +150,7 @@ void ConsoleEdit::setup() {
 
     status = idle;
     promptPosition = -1;
+    fixedPosition = 0;
 
     // added to handle reactive actions
     parsedStart = 0; //parsedLimit = -1;
@@ -148,12 +159,56 @@ void ConsoleEdit::setup() {
     count_output = 0;
     update_refresh_rate = 100;
     preds = 0;
+    ranked = 0;
+    boost_revision = boost_history = -1;
+    history_next = -1;
+    history_compactions = HistoryStore::shared().compactions();
+    history_searching = false;
+    input_pending_from = 0;
+
+    // output from engine is drained from ring buffer, once per frame
+    output_decoder.reset(QTextCodec::codecForName("UTF-8")->makeDecoder());
+    drain_timer.setSingleShot(true);
+    setOutputFrameRate(60);
+    output_high_water = 1 << 18;
+    output_flush_sync = false;
+    connect(&drain_timer, SIGNAL(timeout()), this, SLOT(output_drain()));
+
+    // results of background jobs are tagged, to drop stale ones
+    completion_generation = QSharedPointer<QAtomicInt>(new QAtomicInt);
+    input_colour_generation = QSharedPointer<QAtomicInt>(new QAtomicInt);
+    occurrences_generation = QSharedPointer<QAtomicInt>(new QAtomicInt);
+
+    // keystrokes on visible completion are coalesced
+    completion_timer.setSingleShot(true);
+    setCompletionDelay(60);
+    connect(&completion_timer, SIGNAL(timeout()), this, SLOT(completion_start()));
+
+    // input line is colourised after a typing pause
+    input_colour_timer.setSingleShot(true);
+    input_colour_timer.setInterval(250);
+    connect(&input_colour_timer, SIGNAL(timeout()), this, SLOT(input_colour_start()));
+    input_colouring = false;
+    connect(document(), SIGNAL(contentsChange(int,int,int)), this, SLOT(onContentsChange(int,int,int)));
+
+    // selection occurrences follow visible blocks
+    occurrences_timer.setSingleShot(true);
+    occurrences_timer.setInterval(30);
+    connect(&occurrences_timer, SIGNAL(timeout()), this, SLOT(occurrences_start()));
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), &occurrences_timer, SLOT(start()));
+    visible_stale = false;
 
     Preferences p;
 
+    // bounded document, older output spills to disk
+    scrollback_limit = p.console_scrollback;
+    scrollback_pinned = 0;
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(scrollback_unpin()));
+
     // preset presentation attributes
     output_text_fmt.setForeground(ANSI2col(p.console_out_fore));
     output_text_fmt.setBackground(ANSI2col(p.console_out_back));
+    output_default_fmt = output_text_fmt;
 
     input_text_fmt.setForeground(ANSI2col(p.console_inp_fore));
     input_text_fmt.setBackground(ANSI2col(p.console_inp_back));
@@ -191,7 +246,9 @@ void ConsoleEdit::keyPressEvent(QKeyEvent *event) {
             event->ignore();
             return; // let the completer do default behavior
         default:
-            compinit(c);
+            // results of requests in flight are now stale
+            completion_generation->ref();
+            completion_timer.start();
             break;
         }
     }
@@ -201,6 +258,47 @@ void ConsoleEdit::keyPressEvent(QKeyEvent *event) {
 
     bool accept = true, ret = false, down = true, editable = (cp >= fixedPosition);
 
+    // incremental reverse search: ^R starts or finds older, ^G/Esc restores input,
+    // other control keys accept the entry found and are processed as usual
+    if (editable && !on_completion && (history_searching || (ctrl && k == Key_R))) {
+        history_rebase();
+        if (ctrl && k == Key_R) {
+            if (!history_searching) {
+                history_searching = true;
+                history_search.clear();
+                history_found = -1;
+                c.setPosition(fixedPosition);
+                c.movePosition(c.End, c.KeepAnchor);
+                history_spare = c.selectedText();
+            }
+            history_search_step(history_found);
+            return;
+        }
+        // modifiers alone, as pressed before the next key, keep searching
+        if (k == Key_Shift || k == Key_Control || k == Key_Alt || k == Key_Meta || k == Key_AltGr)
+            return;
+        if (k == Key_Escape || (ctrl && k == Key_G)) {
+            history_searching = false;
+            QToolTip::hideText();
+            history_replace(history_spare);
+            return;
+        }
+        if (k == Key_Backspace) {
+            history_search.chop(1);
+            history_search_step(-1);
+            return;
+        }
+        QString t = event->text();
+        if (!ctrl && !t.isEmpty() && t[0].isPrint()) {
+            history_search += t;
+            history_search_step(history_found < 0 ? -1 : history_found + 1);
+            return;
+        }
+        history_searching = false;
+        QToolTip::hideText();
+        history_next = -1;
+    }
+
     QString cmd;
 
     switch (k) {
@@ -268,36 +366,27 @@ void ConsoleEdit::keyPressEvent(QKeyEvent *event) {
         // fall throu
     case Key_Down:
         if (ctrl) { //if (!ctrl) {
-            // naive history handler
+            // history handler, entries shared by consoles
             if (editable) {
-                if (!history.empty()) {
-
-                    c.setPosition(fixedPosition);
-                    c.movePosition(c.End, c.KeepAnchor);
-
-                    auto repc = [&](QString t) {
-                        c.removeSelectedText();
-                        c.insertText(t, input_text_fmt);
-                        c.movePosition(c.End);
-                        ensureCursorVisible();
-                    };
-
-                    if (down) {
-                        if (history_next < history.count() - 1)
-                            repc(history[++history_next]);
-                        else if (history_next == history.count() - 1) {
-                            ++history_next;
-                            repc(history_spare);
-                        }
-                    } else {
-                        if (history_next == history.count()) {
+                HistoryStore &h = HistoryStore::shared();
+                bool browsing = history_rebase();
+                if (down) {
+                    if (history_next >= 0) {
+                        history_next = h.newer(history_next);
+                        history_replace(history_next >= 0 ? h.at(history_next) : history_spare);
+                    }
+                } else {
+                    int p = h.older(history_next);
+                    if (p >= 0) {
+                        if (history_next < 0 && !browsing) {
+                            c.setPosition(fixedPosition);
+                            c.movePosition(c.End, c.KeepAnchor);
                             history_spare = c.selectedText();
-                            repc(history[--history_next]);
-                        } else if (history_next > 0)
-                            repc(history[--history_next]);
+                        }
+                        history_replace(h.at(history_next = p));
                     }
-                    return;
                 }
+                return;
             }
             event->ignore();
             return;
@@ -324,7 +413,7 @@ void ConsoleEdit::keyPressEvent(QKeyEvent *event) {
     // case Key_Pause: I thought this one also work. It's not true.
         if (ctrl && status == running) {
             qDebug() << "^C" << thids << status;
-            PL_thread_raise(thids[0], SIGINT);
+            int_request();
             return;
         }
         // fall throu
@@ -369,6 +458,9 @@ void ConsoleEdit::keyPressEvent(QKeyEvent *event) {
         if (on_completion) {
             c.select(QTextCursor::WordUnderCursor);
             preds->setCompletionPrefix(c.selectedText());
+            // a debounced job will rank the fresh candidates
+            if (!completion_timer.isActive())
+                ranked->rank(c.selectedText());
             preds->popup()->setCurrentIndex(preds->completionModel()->index(0, 0));
         }
         else {
@@ -389,10 +481,7 @@ void ConsoleEdit::keyPressEvent(QKeyEvent *event) {
         }
 
     _cmd_:
-        if (io)
-            io->take_input(cmd);
-        else
-            emit user_input(cmd);
+        send_input(cmd);
 
     if ( status != eof || !cmd.isEmpty() )
         status = running;
@@ -424,8 +513,10 @@ void ConsoleEdit::insertCompletion(QString completion) {
     int sep = completion.indexOf(" | ");
     if (sep > 0)    // remove description
         completion = completion.left(sep);
-    int extra = completion.length() - preds->completionPrefix().length();
-    textCursor().insertText(completion.right(extra));
+    // fuzzy matches don't extend prefix: replace it
+    QTextCursor c = textCursor();
+    c.movePosition(c.Left, c.KeepAnchor, preds->completionPrefix().length());
+    c.insertText(completion);
 }
 
 /** completion initialize
@@ -445,41 +536,231 @@ void ConsoleEdit::compinit(QTextCursor c) {
 
     QStringList lpreds;
     QString prefix = Completion::initialize(fixedPosition, c, lpreds);
+    completion_show(lpreds, prefix, 300, true);
+}
 
+/** update completer model and popup
+ *  when <fuzzy> and completing an identifier, rank all known names
+ */
+void ConsoleEdit::completion_show(QStringList strings, QString prefix, int width, bool fuzzy) {
     if (!preds) {
-        preds = new t_Completion(new QStringListModel(lpreds));
+        ranked = new RankedModel(this);
+        preds = new t_Completion(ranked, this);
+        preds->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
         preds->setWidget(this);
         connect(preds, SIGNAL(activated(QString)), this, SLOT(insertCompletion(QString)));
     }
-    else {
-        auto model = qobject_cast<QStringListModel*>(preds->model());
-        model->setStringList(lpreds);
+
+    if (fuzzy && !prefix.isEmpty() && Completion::word_prefix(prefix) == prefix && Completion::words.size()) {
+        // known names, plus what the engine found (atoms, completion_job results)
+        QStringList all = Completion::words.words() + Completion::atoms.words() + strings;
+        all.removeDuplicates();
+        ranked->matcher.set_candidates(all);
     }
+    else
+        ranked->matcher.set_candidates(strings);
+    ranked->matcher.set_boost(completion_boost());
+    ranked->rank(prefix);
 
     preds->setCompletionPrefix(prefix);
     preds->popup()->setCurrentIndex(preds->completionModel()->index(0, 0));
 
     QRect cr = cursorRect();
-    cr.setWidth(300);
+    cr.setWidth(width);
     preds->complete(cr);
 }
 
+/** extra rank: names used in history, then names defined in user module
+ */
+QHash<QString, int> ConsoleEdit::completion_boost() {
+    int revision = Completion::local.revision();
+    HistoryStore &h = HistoryStore::shared();
+    if (revision != boost_revision || h.count() != boost_history) {
+        boost_revision = revision;
+        boost_history = h.count();
+        boost.clear();
+
+        foreach (QString n, Completion::local.words())
+            boost[n] = 5;
+
+        static QRegExp id("\\b[a-z][A-Za-z0-9_]*");
+        foreach (QString l, h.lines(1000))
+            for (int p = 0; (p = id.indexIn(l, p)) != -1; p += id.matchedLength()) {
+                int &b = boost[id.cap()];
+                b = qMin(b + 3, 40);
+            }
+    }
+    return boost;
+}
+
+/** run Completion::initialize on a pooled engine
+ *  console is only tested in GUI thread, when the result is delivered
+ */
+class completion_job : public QRunnable {
+public:
+    completion_job(ConsoleEdit *console, QSharedPointer<QAtomicInt> current, int generation, QString before, QString after)
+        : console(console), current(current), generation(generation), before(before), after(after) {}
+
+    virtual void run() {
+        // superseded while queued
+        if (generation != current->loadAcquire())
+            return;
+
+        QStringList strings;
+        QString prefix = Completion::initialize(before, after, strings);
+
+        QPointer<ConsoleEdit> c = console;
+        int g = generation;
+        GuiPost::post([c, g, prefix, strings]() {
+            if (c)
+                c->completion_apply(g, prefix, strings);
+        });
+    }
+
+private:
+    QPointer<ConsoleEdit> console;
+    QSharedPointer<QAtomicInt> current;
+    int generation;
+    QString before, after;
+};
+
+void ConsoleEdit::completion_start() {
+    if (!preds || !preds->popup()->isVisible())
+        return;
+
+    QTextCursor c = textCursor();
+    int p = c.position();
+    if (p < fixedPosition)
+        return;
+
+    c.setPosition(fixedPosition, c.KeepAnchor);
+    QString before = c.selectedText();
+    c.setPosition(p);
+    c.movePosition(c.EndOfLine, c.KeepAnchor);
+    QString after = c.selectedText();
+
+    int generation = completion_generation->fetchAndAddOrdered(1) + 1;
+    QThreadPool::globalInstance()->start(new completion_job(this, completion_generation, generation, before, after));
+}
+
+/** apply only if no newer request, and text before cursor still ends with prefix
+ */
+void ConsoleEdit::completion_apply(int generation, QString prefix, QStringList strings) {
+    if (generation != completion_generation->loadAcquire() || !preds || !preds->popup()->isVisible())
+        return;
+
+    QTextCursor c = textCursor();
+    int p = c.position();
+    if (p < fixedPosition)
+        return;
+    c.setPosition(fixedPosition, c.KeepAnchor);
+    if (!c.selectedText().endsWith(prefix))
+        return;
+
+    completion_show(strings, prefix, 300, true);
+}
+
+class input_colour_job : public QRunnable {
+public:
+    input_colour_job(ConsoleEdit *console, QSharedPointer<QAtomicInt> current, int generation, QString text)
+        : console(console), current(current), generation(generation), text(text) {}
+
+    virtual void run() {
+        // superseded while queued
+        if (generation != current->loadAcquire())
+            return;
+
+        QVariantList fragments;
+        foreach (SemanticColour::fragment f, SemanticColour::colourise_query(QString(text).replace(QChar::ParagraphSeparator, '\n')))
+            fragments.append(QVariant(QVariantList() << f.start << f.length << SemanticColour::class_name(f.cls)));
+
+        QPointer<ConsoleEdit> c = console;
+        int g = generation;
+        QString t = text;
+        GuiPost::post([c, g, t, fragments]() {
+            if (c)
+                c->input_colour_apply(g, t, fragments);
+        });
+    }
+
+private:
+    QPointer<ConsoleEdit> console;
+    QSharedPointer<QAtomicInt> current;
+    int generation;
+    QString text;
+};
+
+void ConsoleEdit::input_colour_start() {
+    QTextCursor c(document());
+    c.setPosition(fixedPosition);
+    c.movePosition(c.End, c.KeepAnchor);
+    QString text = c.selectedText();
+    if (text.trimmed().isEmpty())
+        return;
+
+    int generation = input_colour_generation->fetchAndAddOrdered(1) + 1;
+    QThreadPool::globalInstance()->start(new input_colour_job(this, input_colour_generation, generation, text));
+}
+
+/** reset input attributes, then merge those of classes known to SemanticColour
+ */
+void ConsoleEdit::input_colour_apply(int generation, QString text, QVariantList fragments) {
+    if (generation != input_colour_generation->loadAcquire())
+        return;
+
+    QTextCursor c(document());
+    c.setPosition(fixedPosition);
+    c.movePosition(c.End, c.KeepAnchor);
+    if (c.selectedText() != text)
+        return;
+
+    blockSig bs(this);
+    input_colouring = true;
+    c.setCharFormat(input_text_fmt);
+
+    const QHash<QString, QTextCharFormat> &formats = SemanticColour::formats();
+    foreach (QVariant v, fragments) {
+        QVariantList f = v.toList();
+        auto p = formats.constFind(f[2].toString());
+        if (p != formats.constEnd()) {
+            c.setPosition(fixedPosition + f[0].toInt());
+            c.setPosition(fixedPosition + f[0].toInt() + f[1].toInt(), c.KeepAnchor);
+            c.mergeCharFormat(*p);
+        }
+    }
+    input_colouring = false;
+}
+
+/** any change of input line text (typing, paste, history recall, search)
+ *  restarts colouring, format changes done by input_colour_apply are ignored.
+ *  Changes inside the occurrences snapshot invalidate it
+ */
+void ConsoleEdit::onContentsChange(int position, int charsRemoved, int charsAdded) {
+    if (!is_tty && !input_colouring && position >= fixedPosition)
+        input_colour_timer.start();
+
+    // text of occurrences snapshot changed, unless all before or after it
+    // (a removal reaching the anchor leaves it at position: assume changed)
+    if (visible_index && !visible_stale) {
+        int a = visible_anchor.position();
+        if ((position + charsAdded > a || (charsRemoved && position == a)) && position < a + visible_index->length())
+            visible_stale = true;
+    }
+}
+
 void ConsoleEdit::compinit2(QTextCursor c) {
 
     QStringList atoms;
     QString prefix = Completion::initialize(fixedPosition, c, atoms);
 
-    if (!preds) {
-        preds = new t_Completion(new QStringListModel());
-        preds->setWidget(this);
-        connect(preds, SIGNAL(activated(QString)), this, SLOT(insertCompletion(QString)));
-    }
-
     QStringList lpreds;
+    bool docs = Completion::helpidx_available();
     foreach (auto a, atoms) {
-        auto p = Completion::pred_docs.constFind(a);
-        if (p != Completion::pred_docs.end())
-            foreach (auto d, p.value()) {
+        Completion::t_decls p;
+        if (docs)
+            p = Completion::pred_docs.find(a);
+        if (!p.isEmpty())
+            foreach (auto d, p) {
                 QStringList la;
                 for (int n = 0; n < d.first; ++n)
                     la.append(QString('A' + n));
@@ -492,15 +773,7 @@ void ConsoleEdit::compinit2(QTextCursor c) {
             lpreds.append(a);
     }
 
-    auto model = qobject_cast<QStringListModel*>(preds->model());
-    model->setStringList(lpreds);
-
-    preds->setCompletionPrefix(prefix);
-    preds->popup()->setCurrentIndex(preds->completionModel()->index(0, 0));
-
-    QRect cr = cursorRect();
-    cr.setWidth(400);
-    preds->complete(cr);
+    completion_show(lpreds, prefix, 400, false);
 }
 
 /** handle focus event to keep QCompleter happy
@@ -543,75 +816,190 @@ void ConsoleEdit::user_output(QString text) {
         c.movePosition(QTextCursor::End);
     }
 
-    auto instext = [&](QString text) {
-        c.insertText(text, output_text_fmt);
+    // spans of text are inserted without copying characters: insertText wants a QString
+    auto instext = [&](int offset, int length) {
+        c.insertText(offset == 0 && length == text.length() ? text : QString::fromRawData(text.constData() + offset, length), output_text_fmt);
         // Jan requested extension: put messages *above* the prompt location
         if (status == wait_input) {
-            int ltext = text.length();
-            promptPosition += ltext;
-            fixedPosition += ltext;
+            promptPosition += length;
+            fixedPosition += length;
             ensureCursorVisible();
         }
     };
 
-    // filter and apply (some) ANSI sequence
-    int pos = text.indexOf('\x1B');
-    if (pos >= 0) {
-        int left = 0;
+    // apply ANSI sequences, state kept between calls
+    sgr.parse(text, [&](int offset, int length) {
+        if (sgr.state() != sgr_applied)
+            output_text_fmt = sgr_format(sgr_applied = sgr.state());
+        instext(offset, length);
+    });
 
-        static QRegExp eseq("\x1B\\[(?:(3([0-7]);([01])m)|(0m)|(1m;)|1;3([0-7])m|(1m)|(?:3([0-7])m))");
+    linkto_message_source();
+}
 
-        forever {
-            int pos1 = eseq.indexIn(text, pos);
-            if (pos1 == -1)
-                break;
+/** map SGR attributes to text format
+ *  palette indexes 0-15 are the user configurable colors
+ */
+QTextCharFormat ConsoleEdit::sgr_format(const AnsiSgrState &a) const {
+    auto color = [](int c) -> QColor {
+        if (c & AnsiSgrState::rgb_flag)
+            return QColor(QRgb(c & 0xFFFFFF));
+        if (c < 16)
+            return ANSI2col(c);
+        return QColor(QRgb(AnsiSgrState::xterm256(c)));
+    };
 
-            QStringList lcap = eseq.capturedTexts();
-            Q_ASSERT(lcap.length() == 9); // match captures in eseq, 0 seems unrelated to paren
+    QTextCharFormat f = output_default_fmt;
+    QBrush fg = a.fg == a.color_default ? f.foreground() : QBrush(color(a.fg));
+    QBrush bg = a.bg == a.color_default ? f.background() : QBrush(color(a.bg));
+    if (a.reverse)
+        qSwap(fg, bg);
+    f.setForeground(fg);
+    f.setBackground(bg);
+
+    if (a.bold)
+        f.setFontWeight(QFont::Bold);
+    else if (a.faint)
+        f.setFontWeight(QFont::Light);
+    f.setFontItalic(a.italic);
+    f.setFontUnderline(a.underline);
+    f.setFontStrikeOut(a.strike);
+    return f;
+}
 
-            // put 'out-of-band' text with current attribute, before changing it
-            instext(text.mid(left, pos1 - left));
+/** the object feeding output to this console
+ */
+FlushOutputEvents *ConsoleEdit::output_source() const {
+    if (eng)
+        return eng;
+    return io;
+}
 
-            // map sequence to text attributes
-            QFont::Weight w;
-            QBrush c;
-            int skip = lcap[1].length();
-            if (skip) {
-                QString A = lcap[2], B = lcap[3];
-                w = QFont::Normal;
-                c = ANSI2col(B.toInt(), A == "1");
-            }
-            else if (!lcap[6].isNull()) {
-                skip  = 5;
-                w = QFont::Bold;
-                c = ANSI2col(lcap[6].toInt());
-            }
-            else if ((skip = lcap[7].length()) > 0) {
-                w = QFont::Bold;
-                c = ANSI2col(0);
-            }
-            else if (!lcap[8].isNull()) {
-                skip = 3;
-                w = QFont::Normal;
-                c = ANSI2col(lcap[8].toInt());
-            }
-            else {
-                skip = lcap[4].length() + lcap[5].length();
-                w = QFont::Normal;
-                c = ANSI2col(0);
+/** engine has put output in ring: schedule a drain
+ */
+void ConsoleEdit::output_ready() {
+    if (!drain_timer.isActive())
+        drain_timer.start();
+}
+
+/** move all available output from ring to document
+ *  autoscroll once for the whole chunk
+ */
+void ConsoleEdit::output_drain() {
+    if (FlushOutputEvents *s = output_source()) {
+        s->drain_requested.storeRelease(0);
+        QByteArray bytes;
+        if (s->output.read(bytes) > 0) {
+            s->notify_drained();
+            user_output(output_decoder->toUnicode(bytes));
+            enforce_scrollback();
+            if (status == running) {
+                QTextCursor c = textCursor();
+                c.movePosition(c.End);
+                setTextCursor(c);
+                ensureCursorVisible();
             }
-            output_text_fmt.setFontWeight(w);
-            output_text_fmt.setForeground(c);
+        }
+    }
+}
+
+/** evict oldest blocks when exceeding scrollbackLimit
+ *  allow some slack, to evict in batches. Never touch the editable area.
+ *  While lines paged in are pinned, wait up to twice the limit
+ */
+void ConsoleEdit::enforce_scrollback() {
+    QTextDocument *d = document();
+    if (!scrollback_limit || d->blockCount() <= scrollback_limit + scrollback_limit / 8)
+        return;
+    if (scrollback_pinned && d->blockCount() <= 2 * scrollback_limit)
+        return;
+
+    int evict = d->blockCount() - scrollback_limit;
+    QTextBlock stop = d->findBlockByNumber(evict);
+    int len = stop.position();
+    if (len > fixedPosition || (promptPosition >= 0 && len > promptPosition))
+        return;
+
+    QStringList lines;
+    for (QTextBlock b = d->begin(); b != stop; b = b.next())
+        lines.append(b.text());
+
+    if (!scrollback)
+        scrollback.reset(new ScrollbackLog);
+    if (!scrollback->append(lines))
+        return;
+
+    blockSig bs(this);
+
+    QTextCursor c(d);
+    c.setPosition(len, c.KeepAnchor);
+    c.removeSelectedText();
+    d->clearUndoRedoStacks();
 
-            left = pos = pos1 + skip + 2; // add the SCI
+    fixedPosition -= len;
+    if (promptPosition >= 0)
+        promptPosition -= len;
+    parsedStart = qMax(0, parsedStart - evict);
+    scrollback_pinned = qMax(0, scrollback_pinned - evict);
+}
+
+/** lines paged in are released when out of view
+ */
+void ConsoleEdit::scrollback_unpin() {
+    if (scrollback_pinned && cursorForPosition(QPoint(0, 0)).blockNumber() >= scrollback_pinned) {
+        scrollback_pinned = 0;
+        enforce_scrollback();
+    }
+}
+
+/** search evicted output, return line numbers newest first
+ */
+QList<int> ConsoleEdit::scrollback_find(QString text, int max_matches) {
+    QList<int> found;
+    if (scrollback)
+        for (int l = scrollback->find(text); l >= 0 && found.size() < max_matches; l = scrollback->find(text, l - 1)) {
+            found.append(l);
+            if (l == 0)
+                break;
         }
+    return found;
+}
+
+/** bring back on top of document the newest <n> evicted lines, and show them
+ *  they are pinned, not evicted again until scrolled out of view,
+ *  and message source links are applied again to them
+ */
+int ConsoleEdit::scrollback_page_in(int n) {
+    if (!scrollback)
+        return 0;
+
+    QStringList lines = scrollback->take_last(n);
+    if (!lines.isEmpty()) {
+        QString text = lines.join("\n") + "\n";
+
+        blockSig bs(this);
+
+        QTextCursor c(document());
+        c.insertText(text, output_default_fmt);
 
-        instext(text.mid(pos));
+        fixedPosition += text.length();
+        if (promptPosition >= 0)
+            promptPosition += text.length();
+        parsedStart += lines.size();
+        scrollback_pinned += lines.size();
+
+        link_messages(0, lines.size());
+
+        // show them: scrolling away releases them
+        verticalScrollBar()->setValue(verticalScrollBar()->minimum());
     }
-    else
-        instext(text);
+    return lines.size();
+}
 
-    linkto_message_source();
+/** evicted lines count
+ */
+int ConsoleEdit::scrollback_count() const {
+    return scrollback ? scrollback->count() : 0;
 }
 
 bool ConsoleEdit::match_thread(int thread_id) const {
@@ -622,13 +1010,19 @@ bool ConsoleEdit::match_thread(int thread_id) const {
  */
 void ConsoleEdit::user_prompt(int threadId, bool tty) {
 
+    // output queued before the prompt must be placed first
+    output_drain();
+
     // attach thread IO to this console
-    if (!thids.contains(threadId))
+    if (!thids.contains(threadId)) {
         thids.append(threadId);
+        pqConsole::bind_thread(threadId, this);
+    }
 
     is_tty = tty;
 
-    //Completion::helpidx();
+    // first run maps (or builds) the cached help index on a pooled engine
+    Completion::helpidx();
 
     QTextCursor c = textCursor();
     c.movePosition(QTextCursor::End);
@@ -648,51 +1042,72 @@ void ConsoleEdit::user_prompt(int threadId, bool tty) {
 }
 
 /** resolve error messages positions
- *  but delay replacement after document' block scan
+ *  only blocks completed since last call are scanned, and the regex
+ *  runs only on blocks starting like a message. Links are applied as
+ *  anchor char formats in a single edit block, so text is not replaced.
  */
 void ConsoleEdit::linkto_message_source() {
+    int last = document()->blockCount() - 1;
+    if (parsedStart < last) {
+        link_messages(parsedStart, last);
+        parsedStart = last;
+    }
+}
 
-    auto c = textCursor();
-    struct to_replace_pos { int pos, len; QString html; };
-    QList<to_replace_pos> to_replace;
+/** apply source links to messages in blocks [from, to)
+ */
+void ConsoleEdit::link_messages(int from, int to) {
+
+    QTextDocument *d = document();
+    static QRegExp jmsg("(ERROR|Warning):[ \t]*(([a-zA-Z]:)?[^:]+):([0-9]+)(:([0-9]+))?.*", Qt::CaseSensitive, QRegExp::RegExp2);
+
+    QTextCursor c(d);
+    bool editing = false;
 
     // scan blocks looking for error messages
-    for (QTextBlock block = c.document()->findBlockByNumber(parsedStart);
-         block.blockNumber() < c.document()->blockCount() - 1; block = block.next()) {
-         //block != c.document()->end(); block = block.next()) {
+    for (QTextBlock block = d->findBlockByNumber(from);
+         from < to; block = block.next(), ++from) {
+
+        // prefilter without extracting the text
+        QChar first = d->characterAt(block.position());
+        if (first != 'E' && first != 'W')
+            continue;
 
         QString text = block.text();
-        ++parsedStart;
-
-        static QRegExp jmsg("(ERROR|Warning):[ \t]*(([a-zA-Z]:)?[^:]+):([0-9]+)(:([0-9]+))?.*", Qt::CaseSensitive, QRegExp::RegExp2);
-        if (jmsg.exactMatch(text)) {
-            QStringList parts = jmsg.capturedTexts();
-            QString path = parts[2].trimmed();
-            int opb = path.indexOf('['), clb;
-            if (opb >= 0 && (clb = path.indexOf(']', opb+1)) > opb)
-                path = path.mid(clb + 1).trimmed();
-
-            auto edit = QString("'%1':%2").arg(path).arg(parts[4].trimmed());
-            if (!parts[6].isEmpty())
-                edit += ":" + parts[6];
-
-            int pos = text.indexOf(path);
-            Q_ASSERT(pos > 0);
-
-            // make the source reference clickable
-            to_replace << to_replace_pos {
-                block.position() + pos, path.length(),
-                QString("<a href=\"system:edit(%1)\">%2</a>").arg(edit, path)};
+        if (!jmsg.exactMatch(text))
+            continue;
+
+        QStringList parts = jmsg.capturedTexts();
+        QString path = parts[2].trimmed();
+        int opb = path.indexOf('['), clb;
+        if (opb >= 0 && (clb = path.indexOf(']', opb+1)) > opb)
+            path = path.mid(clb + 1).trimmed();
+
+        auto edit = QString("'%1':%2").arg(path).arg(parts[4].trimmed());
+        if (!parts[6].isEmpty())
+            edit += ":" + parts[6];
+
+        int pos = text.indexOf(path);
+        Q_ASSERT(pos > 0);
+
+        // make the source reference clickable
+        QTextCharFormat link;
+        link.setAnchor(true);
+        link.setAnchorHref(QString("system:edit(%1)").arg(edit));
+        link.setForeground(palette().link());
+        link.setFontUnderline(true);
+
+        if (!editing) {
+            c.beginEditBlock();
+            editing = true;
         }
+        c.setPosition(block.position() + pos);
+        c.setPosition(block.position() + pos + path.length(), c.KeepAnchor);
+        c.mergeCharFormat(link);
     }
 
-    // apply delayed replacement
-    foreach(auto b, to_replace) {
-        c.setPosition(b.pos);
-        c.setPosition(b.pos + b.len, c.KeepAnchor);
-        c.removeSelectedText();
-        c.insertHtml(b.html);
-    }
+    if (editing)
+        c.endEditBlock();
 }
 
 /** push command on queue
@@ -715,7 +1130,30 @@ void ConsoleEdit::command_do() {
     c.movePosition(QTextCursor::End);
     promptPosition = fixedPosition = c.position();
 
-    emit user_input(cmd);
+    send_input(cmd);
+}
+
+/** queue input to engine, after any still held back
+ */
+void ConsoleEdit::send_input(QString cmd) {
+    if (input_pending.isEmpty()) {
+        input_pending = cmd;
+        input_pending_from = 0;
+    }
+    else
+        input_pending += cmd;
+    input_feed();
+}
+
+/** hand held back input to engine, as much as its queue accepts
+ *  the rest waits input_drained
+ */
+void ConsoleEdit::input_feed() {
+    int n = io ? io->take_input(input_pending, input_pending_from) : eng->take_input(input_pending, input_pending_from);
+    if ((input_pending_from += n) == input_pending.length()) {
+        input_pending.clear();
+        input_pending_from = 0;
+    }
 }
 
 /** handle tooltip from helpidx to display current cursor word synopsis
@@ -874,8 +1312,13 @@ void ConsoleEdit::set_cursor_tip(QTextCursor c) {
  */
 void ConsoleEdit::int_request() {
     qDebug() << "int_request" << thids;
-    if (!thids.empty())
+    if (!thids.empty()) {
         PL_thread_raise(thids[0], SIGINT);
+        if (eng)
+            eng->wakeup();
+        else if (io)
+            io->wakeup();
+    }
 }
 
 /** serve the user menu issuing the command
@@ -896,6 +1339,7 @@ void ConsoleEdit::onConsoleMenuActionMap(const QString& action) {
                     int t = PL_thread_self();
                     Q_ASSERT(!target->thids.contains(t));
                     target->thids.append(t);
+                    ConsoleEdit *previous = pqConsole::bind_thread(t, target);
                     try {
                         PL_set_prolog_flag("console_thread", PL_INTEGER, t);
                         PlCall(action.toStdWString().data());
@@ -905,6 +1349,7 @@ void ConsoleEdit::onConsoleMenuActionMap(const QString& action) {
                         qDebug() << CCP(e);
                     }
                     target->thids.removeLast();
+                    pqConsole::unbind_thread(t, target, previous);
                 }
                 return;
             }
@@ -917,7 +1362,7 @@ void ConsoleEdit::onConsoleMenuActionMap(const QString& action) {
  */
 void ConsoleEdit::tty_clear() {
     clear();
-    fixedPosition = promptPosition = parsedStart = 0;
+    fixedPosition = promptPosition = parsedStart = scrollback_pinned = 0;
 }
 
 /** issue instancing in GUI thread (cant moveToThread a Widget)
@@ -953,12 +1398,50 @@ void ConsoleEdit::customEvent(QEvent *event) {
  */
 void ConsoleEdit::add_history_line(QString line)
 {
-    if (history.isEmpty() || history.back() != line)
-        history.append(line);
-    history_next = history.count();
+    HistoryStore::shared().add(line);
+    history_next = -1;
     history_spare.clear();
 }
 
+/** replace input with history entry
+ */
+void ConsoleEdit::history_replace(QString text) {
+    QTextCursor c = textCursor();
+    c.setPosition(fixedPosition);
+    c.movePosition(c.End, c.KeepAnchor);
+    c.removeSelectedText();
+    c.insertText(text, input_text_fmt);
+    c.movePosition(c.End);
+    setTextCursor(c);
+    ensureCursorVisible();
+}
+
+/** another console compacted the shared history: positions held are stale, restart from newest
+ *  true if history was being browsed (the input is not a new line then)
+ */
+bool ConsoleEdit::history_rebase() {
+    bool browsing = history_next >= 0;
+    int n = HistoryStore::shared().compactions();
+    if (n != history_compactions) {
+        history_compactions = n;
+        history_next = history_found = -1;
+        return browsing;
+    }
+    return false;
+}
+
+/** search entries older than <from> (-1 = newest), show the match and the search state
+ */
+void ConsoleEdit::history_search_step(int from) {
+    HistoryStore &h = HistoryStore::shared();
+    int p = history_search.isEmpty() ? -1 : h.find(history_search, from);
+    if (p >= 0)
+        history_replace(h.at(history_found = p));
+
+    QString tip = QString("(%1reverse-i-search)`%2'").arg(p < 0 && !history_search.isEmpty() ? "failed " : "").arg(history_search);
+    QToolTip::showText(viewport()->mapToGlobal(cursorRect().bottomLeft()), tip, this);
+}
+
 /** when engine gracefully complete-...
  */
 void ConsoleEdit::eng_completed() {
@@ -975,47 +1458,53 @@ void ConsoleEdit::eng_completed() {
 
 /** dispatch execution to appropriate object
  */
-void ConsoleEdit::query_run(QString call) {
+pqQueryPtr ConsoleEdit::query_run(QString call, const pqQuery::limits &bounds) {
     if (eng)
-        eng->query_run(call);
-    else if (io)
-        io->query_run(call);
+        return eng->query_run(call, bounds);
+    if (io)
+        return io->query_run(call, bounds);
+    return pqQueryPtr();
 }
 
 /** dispatch qualified execution to appropriate object
  */
-void ConsoleEdit::query_run(QString module, QString call) {
+pqQueryPtr ConsoleEdit::query_run(QString module, QString call, const pqQuery::limits &bounds) {
     if (eng)
-        eng->query_run(module, call);
-    else if (io)
-        query_run(module + ":" + call);
+        return eng->query_run(module, call, bounds);
+    return query_run(module + ":" + call, bounds);
 }
 
 ConsoleEdit::exec_sync::exec_sync(int timeout_ms) : timeout_ms(timeout_ms) {
     stop_ = CT;
-    go_ = 0;
+    posted.start();
 }
+
+static QAtomicInt latency[ConsoleEdit::exec_sync::latency_buckets];
+
 void ConsoleEdit::exec_sync::stop() {
     Q_ASSERT(CT == stop_);
-    for ( ; ; ) {
-        {   QMutexLocker lk(&sync);
-            if (go_)
-                break;
-        }
-        SwiPrologEngine::msleep(10);
+    done.acquire();
+
+    qint64 us = posted.nsecsElapsed() / 1000;
+    int b = 0;
+    while (us > 1 && b < latency_buckets - 1) {
+        us >>= 1;
+        ++b;
     }
-    //Q_ASSERT(go_ && go_ != stop_);
+    latency[b].ref();
 }
 void ConsoleEdit::exec_sync::go() {
-    Q_ASSERT(go_ == 0);
     Q_ASSERT(stop_ != 0);
-    auto t = CT;
-    if (stop_ != t) {
-        QMutexLocker lk(&sync);
-        go_ = t;
-    }
-    else
-        go_ = t;
+    done.release();
+}
+
+/** bucket <b> counts round trips of [2^b, 2^(b+1)) microseconds, first one includes faster
+ */
+QVector<int> ConsoleEdit::exec_sync::latency_histogram(bool reset) {
+    QVector<int> h(latency_buckets);
+    for (int b = 0; b < latency_buckets; ++b)
+        h[b] = reset ? latency[b].fetchAndStoreOrdered(0) : latency[b].loadAcquire();
+    return h;
 }
 
 void ConsoleEdit::setSource(const QUrl &name) {
@@ -1040,34 +1529,125 @@ void ConsoleEdit::set_editable(bool allow) {
     //qDebug() << "after" << textInteractionFlags();
 }
 
+/** mark occurrences of selection, in visible blocks
+ */
 void ConsoleEdit::selectionChanged()
 {
-    blockSig bs(this);
+    QTextCursor c = textCursor();
+    QString csel = c.hasSelection() ? c.selectedText() : QString();
+    if (csel.contains(QChar::ParagraphSeparator))
+        csel.clear();
+
+    if (csel != occurrences_text) {
+        occurrences_text = csel;
+        occurrences_generation->ref();
+        if (csel.isEmpty())
+            setExtraSelections(QList<ExtraSelection>());
+        else
+            occurrences_timer.start();
+    }
+}
 
-    foreach (ExtraSelection s, extraSelections())
-        s.cursor.setCharFormat(s.format);
-    extraSelections().clear();
+/** search in index of visible text
+ */
+class occurrences_job : public QRunnable {
+public:
+    occurrences_job(ConsoleEdit *console, QSharedPointer<QAtomicInt> current, int generation, QString text, QSharedPointer<TextIndex> index)
+        : console(console), current(current), generation(generation), text(text), index(index) {}
+
+    virtual void run() {
+        // superseded while queued
+        if (generation != current->loadAcquire())
+            return;
 
-    QTextCursor c = textCursor();
-    if (c.hasSelection()) {
-        QString csel = c.selectedText();
-        QList<ExtraSelection> lsel;
-        QTextCharFormat bold = ParenMatching::range::bold();
-
-        QTextCursor cfirst = cursorForPosition(QPoint(0, 0));
-        if (!cfirst.isNull()) {
-            while (c.block().position() > cfirst.block().position())
-                c.movePosition(c.Up);
-            c.movePosition(c.Up);
-            for ( ; ; ) {
-                c = document()->find(csel, c, QTextDocument::FindCaseSensitively);
-                if (c.isNull() || !c.block().isVisible())
-                    break;
-                lsel.append(ExtraSelection {c, c.blockCharFormat()});
-                c.setCharFormat(bold);
-            }
-        }
+        QVariantList positions;
+        foreach (int p, index->find(text))
+            positions.append(p);
+
+        QPointer<ConsoleEdit> c = console;
+        int g = generation;
+        QString t = text;
+        QSharedPointer<TextIndex> i = index;
+        GuiPost::post([c, g, t, i, positions]() {
+            if (c)
+                c->occurrences_apply(g, t, i, positions);
+        });
+    }
+
+private:
+    QPointer<ConsoleEdit> console;
+    QSharedPointer<QAtomicInt> current;
+    int generation;
+    QString text;
+    QSharedPointer<TextIndex> index;
+};
+
+/** visible text larger than this is indexed in background */
+static const int occurrences_sync_length = 1 << 15;
+
+void ConsoleEdit::occurrences_start() {
+    if (occurrences_text.isEmpty())
+        return;
+
+    QTextBlock first = cursorForPosition(QPoint(0, 0)).block();
+    QTextBlock last = cursorForPosition(QPoint(viewport()->width(), viewport()->height())).block();
+    if (!first.isValid() || !last.isValid())
+        return;
 
-        setExtraSelections(lsel);
+    // the snapshot is reused while its text is unchanged, wherever it moved
+    int from = first.position(), to = last.position() + last.length() - 1;
+    int shift = visible_index ? visible_anchor.position() - visible_index->base() : 0;
+    if (!visible_index || visible_stale || !visible_index->covers(from - shift, to - shift)) {
+        QStringList lines;
+        for (QTextBlock b = first; b.isValid() && b.position() <= last.position(); b = b.next())
+            lines.append(b.text());
+        visible_index = QSharedPointer<TextIndex>(new TextIndex(lines.join("\n"), from));
+        visible_anchor = QTextCursor(document());
+        visible_anchor.setPosition(from);
+        visible_stale = false;
     }
+
+    int generation = occurrences_generation->fetchAndAddOrdered(1) + 1;
+    if (visible_index->ready() || visible_index->length() < occurrences_sync_length) {
+        QVariantList positions;
+        foreach (int p, visible_index->find(occurrences_text))
+            positions.append(p);
+        occurrences_apply(generation, occurrences_text, visible_index, positions);
+    }
+    else
+        QThreadPool::globalInstance()->start(new occurrences_job(this, occurrences_generation, generation, occurrences_text, visible_index));
+}
+
+/** overlays only, document and undo stack are not touched
+ *  positions are mapped through the snapshot anchor, that follows output inserted before it;
+ *  if the snapshot text changed meanwhile, occurrences still in place are marked and a new pass is scheduled
+ */
+void ConsoleEdit::occurrences_apply(int generation, QString text, QSharedPointer<TextIndex> index, QVariantList positions) {
+    if (generation != occurrences_generation->loadAcquire() || text != occurrences_text || index != visible_index)
+        return;
+
+    QTextDocument *d = document();
+    int shift = visible_anchor.position() - index->base();
+    auto in_place = [&](int p) {
+        for (int i = 0; i < text.length(); ++i)
+            if (d->characterAt(p + i) != text[i])
+                return false;
+        return true;
+    };
+
+    QList<ExtraSelection> lsel;
+    QTextCharFormat bold = ParenMatching::range::bold();
+    foreach (QVariant v, positions) {
+        int p = v.toInt() + shift;
+        if (visible_stale && !in_place(p))
+            continue;
+        QTextCursor c(d);
+        c.setPosition(p);
+        c.setPosition(p + text.length(), c.KeepAnchor);
+        lsel.append(ExtraSelection {c, bold});
+    }
+    setExtraSelections(lsel);
+
+    if (visible_stale)
+        occurrences_timer.start();
 }
@@ -24,7 +24,14 @@
 #define CONSOLEEDIT_H
 
 #include <QEvent>
+#include <QTimer>
 #include <QCompleter>
+#include <QAtomicInt>
+#include <QTextDecoder>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QSemaphore>
+#include <QElapsedTimer>
 
 // make this definition available in client projects
 #define PQCONSOLE_BROWSER
@@ -44,6 +51,11 @@
 #include "SwiPrologEngine.h"
 #include "Completion.h"
 #include "ParenMatching.h"
+#include "ScrollbackLog.h"
+#include "AnsiSgrParser.h"
+#include "RankedModel.h"
+#include "TextIndex.h"
+#include "HistoryStore.h"
 
 class Swipl_IO;
 
@@ -53,6 +65,11 @@ class Swipl_IO;
 class PQCONSOLESHARED_EXPORT ConsoleEdit : public ConsoleEditBase {
     Q_OBJECT
     Q_PROPERTY(int updateRefreshRate READ updateRefreshRate WRITE setUpdateRefreshRate)
+    Q_PROPERTY(int outputFrameRate READ outputFrameRate WRITE setOutputFrameRate)
+    Q_PROPERTY(int outputHighWater READ outputHighWater WRITE setOutputHighWater)
+    Q_PROPERTY(bool outputFlushSync READ outputFlushSync WRITE setOutputFlushSync)
+    Q_PROPERTY(int scrollbackLimit READ scrollbackLimit WRITE setScrollbackLimit)
+    Q_PROPERTY(int completionDelay READ completionDelay WRITE setCompletionDelay)
 
 public:
 
@@ -90,6 +107,35 @@ public:
     int updateRefreshRate() const { return update_refresh_rate; }
     void setUpdateRefreshRate(int v) { update_refresh_rate = v; }
 
+    /** repaint/autoscroll at most these times per second */
+    int outputFrameRate() const { return 1000 / drain_timer.interval(); }
+    void setOutputFrameRate(int v) { drain_timer.setInterval(1000 / qBound(1, v, 1000)); }
+
+    /** engine waits on GUI only when pending output exceeds this (bytes) */
+    int outputHighWater() const { return output_high_water; }
+    void setOutputHighWater(int v) { output_high_water = v; }
+
+    /** revert to flushing in lockstep with GUI */
+    bool outputFlushSync() const { return output_flush_sync; }
+    void setOutputFlushSync(bool v) { output_flush_sync = v; }
+
+    /** keep at most these blocks in document, older spill to disk (0 = unlimited) */
+    int scrollbackLimit() const { return scrollback_limit; }
+    void setScrollbackLimit(int v) { scrollback_limit = qMax(0, v); enforce_scrollback(); }
+
+    /** while completion popup is visible, wait these ms of typing pause before refresh */
+    int completionDelay() const { return completion_timer.interval(); }
+    void setCompletionDelay(int v) { completion_timer.setInterval(qMax(0, v)); }
+
+    /** search evicted output, return line numbers newest first */
+    QList<int> scrollback_find(QString text, int max_matches = 100);
+
+    /** bring back on top of document the newest <n> evicted lines, kept until scrolled out of view */
+    int scrollback_page_in(int n);
+
+    /** evicted lines count */
+    int scrollback_count() const;
+
     /** create a new console, bound to calling thread */
     void new_console(Swipl_IO *e, QString title);
 
@@ -99,21 +145,28 @@ public:
     /** 4. attempt to run generic code inter threads */
     void exec_func(pfunc f) { emit sig_run_function(f); }
 
-    /** 5. helper syncronization for modal loop */
+    /** 5. helper syncronization for modal loop
+     *  stop() blocks on a semaphore released by go(), and records round trip latency
+     */
     struct PQCONSOLESHARED_EXPORT exec_sync {
         exec_sync(int timeout_ms = 100);
 
         void stop();
         void go();
 
+        /** round trips count by log2(microseconds) bucket */
+        enum { latency_buckets = 24 };
+        static QVector<int> latency_histogram(bool reset = false);
+
     private:
-        QThread *stop_, *go_;
-        QMutex sync;
+        QThread *stop_;
+        QSemaphore done;
+        QElapsedTimer posted;
         int timeout_ms;
     };
 
     /** give access to rl_... predicates */
-    const QStringList& history_lines() const { return history; }
+    QStringList history_lines() const { return HistoryStore::shared().lines(); }
     void add_history_line(QString line);
 
     /** run interrupt/0 */
@@ -142,6 +195,27 @@ protected:
     /** can't get <eng> to work on a foreign thread - initiated from SWI-Prolog */
     Swipl_IO *io;
 
+    /** the object feeding output to this console (either eng or io) */
+    FlushOutputEvents *output_source() const;
+
+    /** frame pacing: coalesce output notifications, drain ring in large chunks */
+    QTimer drain_timer;
+
+    /** keep UTF-8 sequences split between chunks */
+    QScopedPointer<QTextDecoder> output_decoder;
+
+    /** see outputHighWater, outputFlushSync */
+    int output_high_water;
+    bool output_flush_sync;
+
+    /** bounded document: evict oldest blocks to disk */
+    int scrollback_limit;
+    QScopedPointer<ScrollbackLog> scrollback;
+    void enforce_scrollback();
+
+    /** top blocks paged in from scrollback, kept while in view */
+    int scrollback_pinned;
+
     /** strict control on keyboard events required */
     virtual void keyPressEvent(QKeyEvent *event);
 
@@ -171,6 +245,14 @@ protected:
     /** output/input text attributes */
     QTextCharFormat output_text_fmt, input_text_fmt;
 
+    /** output attributes when no SGR is active */
+    QTextCharFormat output_default_fmt;
+
+    /** incremental decoder of ANSI sequences, and last attributes mapped */
+    AnsiSgrParser sgr;
+    AnsiSgrState sgr_applied;
+    QTextCharFormat sgr_format(const AnsiSgrState &a) const;
+
     /** start point of engine output insertion */
     /** i.e. keep last user editable position */
     int fixedPosition;
@@ -178,11 +260,28 @@ protected:
     /** commands to be dispatched to engine thread */
     QStringList commands;
 
-    /** poor man command history */
-    QStringList history;
+    /** input not yet accepted by engine bounded queue, sent from <input_pending_from> */
+    QString input_pending;
+    int input_pending_from;
+    void send_input(QString cmd);
+
+    /** command history is kept in HistoryStore::shared()
+     *  history_next is the position shown, -1 while editing a new line
+     */
     int history_next;
     QString history_spare;
 
+    /** positions held are valid for this HistoryStore::compactions() */
+    int history_compactions;
+    bool history_rebase();
+
+    /** incremental reverse search (^R), shown in a tooltip */
+    bool history_searching;
+    QString history_search;
+    int history_found;
+    void history_search_step(int from);
+    void history_replace(QString text);
+
     /** count output before setting cursor at end */
     int count_output;
 
@@ -195,9 +294,38 @@ protected:
     t_Completion *preds;
     QStringList lmodules;
 
+    /** fuzzy ranked completion, viewed by preds */
+    RankedModel *ranked;
+    QHash<QString, int> boost;
+    int boost_revision, boost_history;
+    QHash<QString, int> completion_boost();
+
     /** factorize code, attempt to get visual clue from QCompleter */
     void compinit(QTextCursor c);
     void compinit2(QTextCursor c);
+    void completion_show(QStringList strings, QString prefix, int width, bool fuzzy);
+
+    /** debounced refresh of visible completion, computed on a pooled engine
+     *  a newer request bumps generation, and older results are dropped.
+     *  Generations are shared with jobs, that can outlive this console
+     */
+    QTimer completion_timer;
+    QSharedPointer<QAtomicInt> completion_generation;
+
+    /** input line colouring from prolog_colourise_query, computed on a pooled engine */
+    QTimer input_colour_timer;
+    QSharedPointer<QAtomicInt> input_colour_generation;
+    bool input_colouring;
+
+    /** occurrences of selected text, marked with ExtraSelection in visible blocks only
+     *  from an index of visible text, built off GUI thread when large
+     */
+    QString occurrences_text;
+    QTimer occurrences_timer;
+    QSharedPointer<QAtomicInt> occurrences_generation;
+    QSharedPointer<TextIndex> visible_index;
+    QTextCursor visible_anchor;     // follows the snapshot start as text is inserted before
+    bool visible_stale;             // snapshot text changed since taken
 
     /** associated thread id (see PL_thread_self()) */
     QList<int> thids;
@@ -223,8 +351,8 @@ protected:
     /** need to sense the processor type to execute code
      *  bypass IO based execution, direct calling
      */
-    void query_run(QString call);
-    void query_run(QString module, QString call);
+    pqQueryPtr query_run(QString call, const pqQuery::limits &bounds = pqQuery::limits());
+    pqQueryPtr query_run(QString module, QString call, const pqQuery::limits &bounds = pqQuery::limits());
 
     /** check if line content is appropriate, then highlight or open editor on it */
     void clickable_message_line(QTextCursor c, bool highlight);
@@ -244,6 +372,7 @@ protected:
 
     /** replace references to source of error/warning with links */
     void linkto_message_source();
+    void link_messages(int from, int to);
 
 protected:
 
@@ -255,6 +384,15 @@ public slots:
     /** display different cursor where editing available */
     void onCursorPositionChanged();
 
+    /** restart input line colouring when its text changed, track occurrences snapshot */
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+    /** engine input queue drained: send more of held back input */
+    void input_feed();
+
+    /** release paged in lines scrolled out of view */
+    void scrollback_unpin();
+
     /** serve console menus */
     void onConsoleMenuAction();
     void onConsoleMenuActionMap(const QString &action);
@@ -262,6 +400,30 @@ public slots:
     /** 2. attempt to run generic code inter threads */
     void run_function(pfunc f) { f(); }
 
+    /** engine has put output in ring: schedule a drain */
+    void output_ready();
+
+    /** move all available output from ring to document */
+    void output_drain();
+
+    /** start background completion for current cursor */
+    void completion_start();
+
+    /** show background completion, if still current */
+    void completion_apply(int generation, QString prefix, QStringList strings);
+
+    /** start background colouring of input line */
+    void input_colour_start();
+
+    /** apply colouring fragments [Start, Length, Class], if input still matches text */
+    void input_colour_apply(int generation, QString text, QVariantList fragments);
+
+    /** locate occurrences of selected text in visible blocks */
+    void occurrences_start();
+
+    /** mark occurrences positions, if still current */
+    void occurrences_apply(int generation, QString text, QSharedPointer<TextIndex> index, QVariantList positions);
+
 protected slots:
 
     /** send text to output */
@@ -287,9 +449,6 @@ protected slots:
 
 signals:
 
-    /** issued to serve prompt */
-    void user_input(QString);
-
     /** 3. attempt to run generic code inter threads */
     void sig_run_function(pfunc f);
 
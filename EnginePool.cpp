@@ -0,0 +1,131 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "EnginePool.h"
+#include <QByteArray>
+#include <QtDebug>
+#include <string.h>
+
+QMutex EnginePool::sync;
+QList<PL_engine_t> EnginePool::idle;
+EnginePool::stats_t EnginePool::counters = { 2, 0, 0, 0, 0, 0, 0, 0 };
+bool EnginePool::ready;
+
+int EnginePool::capacity() {
+    QMutexLocker lk(&sync);
+    return counters.capacity;
+}
+
+/** shrinking destroys exceeding idle engines
+ */
+void EnginePool::set_capacity(int n) {
+    QMutexLocker lk(&sync);
+    counters.capacity = qMax(0, n);
+    while (idle.size() > counters.capacity) {
+        PL_destroy_engine(idle.takeLast());
+        ++counters.destroyed;
+    }
+}
+
+/** called from Prolog main thread, after PL_initialise
+ */
+void EnginePool::prefill() {
+    QMutexLocker lk(&sync);
+    while (idle.size() < counters.capacity)
+        if (PL_engine_t e = create())
+            idle.append(e);
+        else
+            break;
+    ready = true;
+}
+
+bool EnginePool::is_ready() {
+    QMutexLocker lk(&sync);
+    return ready;
+}
+
+/** must be called with <sync> locked
+ */
+PL_engine_t EnginePool::create() {
+    PL_thread_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.flags = PL_THREAD_NO_DEBUG;
+
+    // aliases must be unique
+    QByteArray alias = "_gt_pool_" + QByteArray::number(counters.created);
+    attr.alias = alias.data();
+
+    PL_engine_t e = PL_create_engine(&attr);
+    if (e)
+        ++counters.created;
+    else
+        qDebug() << "EnginePool: PL_create_engine failed";
+    return e;
+}
+
+PL_engine_t EnginePool::checkout() {
+    PL_engine_t e = 0;
+    {   QMutexLocker lk(&sync);
+        ++counters.checkouts;
+        if (!idle.isEmpty())
+            e = idle.takeLast();
+        else {
+            ++counters.misses;
+            e = create();
+        }
+        if (e)
+            counters.max_in_use = qMax(counters.max_in_use, ++counters.in_use);
+    }
+    if (e && PL_set_engine(e, 0) != PL_ENGINE_SET) {
+        qDebug() << "EnginePool: PL_set_engine failed";
+        QMutexLocker lk(&sync);
+        --counters.in_use;
+        PL_destroy_engine(e);
+        ++counters.destroyed;
+        e = 0;
+    }
+    return e;
+}
+
+/** engine leaves calling thread, back to idle list unless pool is full
+ */
+void EnginePool::checkin(PL_engine_t e) {
+    PL_engine_t current = 0;
+    if (PL_set_engine(0, &current) == PL_ENGINE_SET && current != e)
+        qDebug() << "EnginePool: checkin of unbound engine";
+
+    QMutexLocker lk(&sync);
+    --counters.in_use;
+    if (idle.size() < counters.capacity)
+        idle.append(e);
+    else {
+        PL_destroy_engine(e);
+        ++counters.destroyed;
+    }
+}
+
+EnginePool::stats_t EnginePool::stats() {
+    QMutexLocker lk(&sync);
+    stats_t s = counters;
+    s.idle = idle.size();
+    return s;
+}
@@ -0,0 +1,74 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ENGINEPOOL_H
+#define ENGINEPOOL_H
+
+#include "pqConsole_global.h"
+#include <SWI-Prolog.h>
+#include <QMutex>
+#include <QList>
+
+/** engines created in advance, to be bound on demand to foreign threads
+ *  Attaching a thread to Prolog and destroying it later costs milliseconds,
+ *  while binding a ready engine with PL_set_engine is cheap.
+ *  Used by SwiPrologEngine::in_thread.
+ */
+class PQCONSOLESHARED_EXPORT EnginePool {
+public:
+
+    /** engines kept idle in pool */
+    static int capacity();
+    static void set_capacity(int n);
+
+    /** Prolog is initialized: create engines up to capacity */
+    static void prefill();
+
+    /** true after prefill() */
+    static bool is_ready();
+
+    /** bind an engine to calling thread (that must have none)
+     *  when pool is empty, a new one is created
+     */
+    static PL_engine_t checkout();
+
+    /** unbind engine from calling thread, keep it for next checkout */
+    static void checkin(PL_engine_t e);
+
+    /** usage counters, to size the pool */
+    struct stats_t {
+        int capacity, idle, in_use, max_in_use;
+        long created, destroyed, checkouts, misses;
+    };
+    static stats_t stats();
+
+private:
+
+    static PL_engine_t create();
+
+    static QMutex sync;
+    static QList<PL_engine_t> idle;
+    static stats_t counters;
+    static bool ready;
+};
+
+#endif // ENGINEPOOL_H
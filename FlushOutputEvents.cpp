@@ -34,12 +34,27 @@ FlushOutputEvents::FlushOutputEvents(ConsoleEdit *target, int msec_delta_refresh
     measure_calls.start();
 }
 
+/** make output visible to user
+ *  by default the console drains and autoscrolls at most once per frame,
+ *  and the engine only waits when output piles up over the high-water mark.
+ *  The old rendezvous (stop engine til GUI has repainted) is still
+ *  available by setting outputFlushSync(true).
+ */
 void FlushOutputEvents::flush() {
-    if (target && measure_calls.elapsed() >= msec_delta_refresh) {
+    if (!target)
+        return;
+
+    if (!target->outputFlushSync()) {
+        wait_drained(target->outputHighWater());
+        return;
+    }
+
+    if (measure_calls.elapsed() >= msec_delta_refresh) {
 
         ConsoleEdit::exec_sync s;
 
         target->exec_func([&]() {
+            target->output_drain();
             QTextCursor c = target->textCursor();
             c.movePosition(c.End);
             target->setTextCursor(c);
@@ -52,3 +67,55 @@ void FlushOutputEvents::flush() {
         measure_calls.restart();
     }
 }
+
+/** append engine output to ring, wake the console to drain it
+ *  only one notification is queued until the console drains.
+ *  Waiting on a full ring is done without holding <writers>,
+ *  and the GUI thread never blocks on it: it drains inline meanwhile
+ */
+void FlushOutputEvents::queue_output(const char *buf, size_t len) {
+    bool gui = target && target->thread() == QThread::currentThread();
+    while (len > 0 && target) {
+        if (gui) {
+            while (target && !output.writers.tryLock())
+                target->output_drain();
+            if (!target)
+                break;
+        }
+        else
+            output.writers.lock();
+
+        int n = output.write(buf, int(qMin(len, size_t(output.size()))));
+        buf += n;
+        len -= n;
+        output.writers.unlock();
+
+        if (drain_requested.testAndSetOrdered(0, 1))
+            QMetaObject::invokeMethod(target, "output_ready", Qt::QueuedConnection);
+
+        if (len > 0)    // ring full: let the GUI catch up
+            wait_drained(output.size() - 1);
+    }
+}
+
+/** block producer while more than <high_water> bytes are pending
+ */
+void FlushOutputEvents::wait_drained(int high_water) {
+    if (target && target->thread() == QThread::currentThread()) {
+        // can't wait on ourselves
+        if (output.available() > high_water)
+            target->output_drain();
+        return;
+    }
+
+    QMutexLocker lk(&drain_sync);
+    while (target && output.available() > high_water)
+        drained.wait(&drain_sync, 50);
+}
+
+/** consumer side: wake producers waiting on high-water mark
+ */
+void FlushOutputEvents::notify_drained() {
+    QMutexLocker lk(&drain_sync);
+    drained.wakeAll();
+}
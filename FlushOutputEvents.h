@@ -24,7 +24,9 @@
 #define FLUSHOUTPUTEVENTS_H
 
 #include "pqConsole_global.h"
+#include "OutputRing.h"
 #include <QElapsedTimer>
+#include <QWaitCondition>
 #include <QThread>
 #include <QPointer>
 
@@ -37,9 +39,27 @@ struct PQCONSOLESHARED_EXPORT FlushOutputEvents {
     FlushOutputEvents(ConsoleEdit *target = 0, int msec_delta_refresh = 10);
     void flush();
 
+    /** append engine output to ring, wake the console to drain it */
+    void queue_output(const char *buf, size_t len);
+
     QPointer<ConsoleEdit> target;
     QElapsedTimer measure_calls;
     int msec_delta_refresh;
+
+    /** engine output, drained by target in GUI thread */
+    OutputRing output;
+
+    /** set when a drain notification is in flight */
+    QAtomicInt drain_requested;
+
+    /** block producer while more than <high_water> bytes are pending */
+    void wait_drained(int high_water);
+
+    /** consumer side: wake producers waiting on high-water mark */
+    void notify_drained();
+
+    QMutex drain_sync;
+    QWaitCondition drained;
 };
 
 #endif // FLUSHOUTPUTEVENTS_H
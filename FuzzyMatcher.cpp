@@ -0,0 +1,108 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "FuzzyMatcher.h"
+#include <algorithm>
+
+quint64 FuzzyMatcher::signature(const QString &s) {
+    quint64 m = 0;
+    for (int i = 0; i < s.length(); ++i) {
+        ushort c = s[i].toLower().unicode();
+        int bit;
+        if (c >= 'a' && c <= 'z')
+            bit = c - 'a';
+        else if (c >= '0' && c <= '9')
+            bit = 26 + c - '0';
+        else if (c == '_')
+            bit = 36;
+        else
+            bit = 37 + c % 27;
+        m |= quint64(1) << bit;
+    }
+    return m;
+}
+
+void FuzzyMatcher::set_candidates(QStringList words, int key) {
+    if (key >= 0 && key == this->key)
+        return;
+    this->key = key;
+    this->words = words;
+    signatures.resize(words.size());
+    for (int i = 0; i < words.size(); ++i)
+        signatures[i] = signature(words[i]);
+}
+
+/** greedy, left to right: consecutive matches and matches at word
+ *  boundaries (start, after _ or a separator, camel hump) score more
+ */
+int FuzzyMatcher::score(const QString &word, const QString &pattern) {
+    int s = 0, w = 0, last = -2;
+    for (int p = 0; p < pattern.length(); ++p) {
+        QChar c = pattern[p].toLower();
+        while (w < word.length() && word[w].toLower() != c)
+            ++w;
+        if (w == word.length())
+            return -1;
+
+        s += 1;
+        if (w == last + 1)
+            s += 5;
+        if (w == 0)
+            s += 10;
+        else if (!word[w - 1].isLetterOrNumber() || (word[w].isUpper() && word[w - 1].isLower()))
+            s += 8;
+        if (p == 0)
+            s -= qMin(w, 5);
+
+        last = w++;
+    }
+    // shorter candidates are closer
+    return s * 4 - qMin(word.length() - pattern.length(), 20) / 4;
+}
+
+QVector<int> FuzzyMatcher::rank(QString pattern, int max) const {
+    const int n = signatures.size();
+    const quint64 q = signature(pattern);
+    const quint64 *sig = signatures.constData();
+
+    // prefilter: no branch in loop body
+    QVector<uchar> pass(n);
+    uchar *ps = pass.data();
+    for (int i = 0; i < n; ++i)
+        ps[i] = (sig[i] & q) == q;
+
+    QVector< QPair<int, int> > scored;
+    for (int i = 0; i < n; ++i)
+        if (ps[i]) {
+            int s = score(words[i], pattern);
+            if (s >= 0)
+                scored.append(qMakePair(-(s + boost.value(words[i])), i));
+        }
+
+    int k = qMin(max, scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + k, scored.end());
+
+    QVector<int> ranked(k);
+    for (int i = 0; i < k; ++i)
+        ranked[i] = scored[i].second;
+    return ranked;
+}
@@ -0,0 +1,65 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include "pqConsole_global.h"
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+
+/** rank candidates matching a pattern as (case insensitive) subsequence
+ *  Each candidate has a 64 bit signature of the characters it contains:
+ *  a candidate can match only if it covers the pattern signature, and this
+ *  test runs on a contiguous array in a branch free loop, that compilers vectorize.
+ *  Only survivors are scored.
+ */
+class PQCONSOLESHARED_EXPORT FuzzyMatcher {
+public:
+
+    FuzzyMatcher() : key(-1) {}
+
+    /** replace candidates, unless <key> (if >= 0) is the same of last call */
+    void set_candidates(QStringList words, int key = -1);
+    const QStringList& candidates() const { return words; }
+
+    /** extra score by candidate, i.e. usage frequency or locality */
+    void set_boost(const QHash<QString, int> &boost) { this->boost = boost; }
+
+    /** indices into candidates, best first */
+    QVector<int> rank(QString pattern, int max = 1000) const;
+
+    /** subsequence score, -1 if <pattern> doesn't match <word> */
+    static int score(const QString &word, const QString &pattern);
+
+    /** which characters classes appear */
+    static quint64 signature(const QString &s);
+
+private:
+    QStringList words;
+    QVector<quint64> signatures;
+    QHash<QString, int> boost;
+    int key;
+};
+
+#endif // FUZZYMATCHER_H
@@ -0,0 +1,51 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "GuiPost.h"
+#include <QCoreApplication>
+
+static const QEvent::Type post_event = QEvent::Type(QEvent::registerEventType());
+
+struct func_event : public QEvent {
+    std::function<void()> f;
+    func_event(std::function<void()> f) : QEvent(post_event), f(f) {}
+};
+
+/** created on first use, then moved to application thread
+ */
+GuiPost *GuiPost::instance() {
+    static GuiPost *i = []() {
+        GuiPost *g = new GuiPost;
+        g->moveToThread(QCoreApplication::instance()->thread());
+        return g;
+    }();
+    return i;
+}
+
+void GuiPost::post(std::function<void()> f) {
+    QCoreApplication::postEvent(instance(), new func_event(f));
+}
+
+void GuiPost::customEvent(QEvent *event) {
+    if (event->type() == post_event)
+        static_cast<func_event*>(event)->f();
+}
@@ -0,0 +1,50 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef GUIPOST_H
+#define GUIPOST_H
+
+#include "pqConsole_global.h"
+#include <QObject>
+#include <QEvent>
+#include <functional>
+
+/** run closures in GUI thread, asynchronously
+ *  worker threads deliver results this way: a closure capturing a QPointer
+ *  tests it on GUI side, where it's safe
+ */
+class PQCONSOLESHARED_EXPORT GuiPost : public QObject {
+    Q_OBJECT
+public:
+
+    /** queue f, callable from any thread */
+    static void post(std::function<void()> f);
+
+protected:
+    virtual void customEvent(QEvent *event);
+
+private:
+    GuiPost() {}
+    static GuiPost *instance();
+};
+
+#endif // GUIPOST_H
@@ -0,0 +1,145 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "HelpIndex.h"
+#include <QSaveFile>
+#include <QByteArray>
+#include <QVector>
+#include <QtDebug>
+#include <algorithm>
+#include <string.h>
+
+static const char magic[4] = { 'P', 'Q', 'H', 'I' };
+enum { format = 1 };
+
+HelpIndex::HelpIndex() : base(0), length(0), count(0) {}
+
+bool HelpIndex::build(QString path, QList<entry> entries) {
+    struct row { QByteArray name, descr; int arity; };
+    QVector<row> rows;
+    rows.reserve(entries.size());
+    foreach (const entry &e, entries) {
+        row r = { e.name.toUtf8(), e.descr.toUtf8(), e.arity };
+        rows.append(r);
+    }
+    std::sort(rows.begin(), rows.end(), [](const row &a, const row &b) {
+        return a.name < b.name || (a.name == b.name && a.arity < b.arity);
+    });
+
+    QByteArray table, blob;
+    foreach (const row &r, rows) {
+        record x;
+        x.name_off = quint32(blob.size());
+        x.name_len = quint16(r.name.size());
+        blob.append(r.name);
+        x.descr_off = quint32(blob.size());
+        x.descr_len = quint32(r.descr.size());
+        blob.append(r.descr);
+        x.arity = qint16(r.arity);
+        table.append(reinterpret_cast<const char*>(&x), sizeof(x));
+    }
+
+    header h;
+    memcpy(h.magic, magic, sizeof(magic));
+    h.format = format;
+    h.count = quint32(rows.size());
+    h.strings = quint32(sizeof(h) + table.size());
+
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+    f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    f.write(table);
+    f.write(blob);
+    return f.commit();
+}
+
+/** header and each record are checked against file size:
+ *  a truncated or foreign file is rejected, so it gets rebuilt
+ */
+bool HelpIndex::open(QString path) {
+    if (base) {
+        file.unmap(const_cast<uchar*>(base));
+        file.close();
+        base = 0;
+        length = count = 0;
+    }
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(header)))
+        return false;
+
+    length = file.size();
+    base = file.map(0, length);
+    if (!base)
+        return false;
+
+    if (!valid()) {
+        qDebug() << "HelpIndex: invalid" << path;
+        file.unmap(const_cast<uchar*>(base));
+        file.close();
+        base = 0;
+        length = 0;
+        return false;
+    }
+
+    count = reinterpret_cast<const header*>(base)->count;
+    return true;
+}
+
+bool HelpIndex::valid() const {
+    const header *h = reinterpret_cast<const header*>(base);
+    if (memcmp(h->magic, magic, sizeof(magic)) || h->format != format)
+        return false;
+
+    // strings follow the table
+    quint64 table_end = sizeof(header) + quint64(h->count) * sizeof(record);
+    if (table_end > quint64(length) || h->strings != table_end)
+        return false;
+
+    quint64 size = quint64(length) - h->strings;
+    const record *r = records();
+    for (quint32 i = 0; i < h->count; ++i, ++r)
+        if (quint64(r->name_off) + r->name_len > size || quint64(r->descr_off) + r->descr_len > size)
+            return false;
+    return true;
+}
+
+QList< QPair<int, QString> > HelpIndex::find(QString name) const {
+    QList< QPair<int, QString> > decls;
+    if (!count)
+        return decls;
+
+    QByteArray key = name.toUtf8();
+    const char *s = strings();
+    auto less = [&](const record &r, const QByteArray &k) {
+        int c = memcmp(s + r.name_off, k.constData(), qMin(int(r.name_len), k.size()));
+        return c < 0 || (c == 0 && r.name_len < k.size());
+    };
+
+    const record *first = records(), *last = first + count;
+    for (const record *r = std::lower_bound(first, last, key, less);
+            r != last && r->name_len == key.size() && !memcmp(s + r->name_off, key.constData(), r->name_len); ++r)
+        decls.append(qMakePair(int(r->arity), QString::fromUtf8(s + r->descr_off, int(r->descr_len))));
+
+    return decls;
+}
@@ -0,0 +1,89 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HELPINDEX_H
+#define HELPINDEX_H
+
+#include "pqConsole_global.h"
+#include <QFile>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+/** predicates synopsis, from library(helpidx), in a memory mapped file
+ *  The file holds a table of fixed size records sorted by name (UTF-8),
+ *  followed by the strings. Lookup is a binary search on the mapped table,
+ *  only matching descriptions are decoded.
+ */
+class PQCONSOLESHARED_EXPORT HelpIndex {
+public:
+
+    HelpIndex();
+
+    /** a row of help_index:predicate/5 */
+    struct entry {
+        QString name;
+        int arity;  // -1 when not an integer
+        QString descr;
+    };
+
+    /** write the binary index, replacing <path> atomically */
+    static bool build(QString path, QList<entry> entries);
+
+    /** map <path>, false if missing or invalid (bad header, records out of file) */
+    bool open(QString path);
+
+    /** arity, description of declarations of <name> */
+    QList< QPair<int, QString> > find(QString name) const;
+
+    /** records count */
+    int size() const { return int(count); }
+    bool isEmpty() const { return count == 0; }
+
+private:
+
+    struct header {
+        char magic[4];
+        quint32 format;
+        quint32 count;
+        quint32 strings;    // offset of strings from file start
+    };
+    struct record {
+        quint32 name_off;   // offsets relative to strings
+        quint32 descr_off;
+        quint32 descr_len;
+        quint16 name_len;
+        qint16 arity;
+    };
+
+    QFile file;
+    const uchar *base;
+    qint64 length;
+    quint32 count;
+
+    bool valid() const;
+
+    const record *records() const { return reinterpret_cast<const record*>(base + sizeof(header)); }
+    const char *strings() const { return reinterpret_cast<const char*>(base) + reinterpret_cast<const header*>(base)->strings; }
+};
+
+#endif // HELPINDEX_H
@@ -0,0 +1,225 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "HistoryStore.h"
+#include "Preferences.h"
+#include <QDir>
+#include <QFile>
+#include <QSet>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QStandardPaths>
+#include <QDebug>
+
+HistoryStore &HistoryStore::shared() {
+    static HistoryStore store([]() {
+        QString dir = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
+        QDir().mkpath(dir);
+        return dir + "/history";
+    }(), Preferences().console_history);
+    return store;
+}
+
+/** one entry per line, with newlines and backslashes escaped
+ */
+HistoryStore::HistoryStore(QString path, int max_entries) : path(path), max_entries(max_entries) {
+    QFile f(path);
+    if (!f.open(f.ReadOnly | f.Text))
+        return;
+
+    QTextStream s(&f);
+    s.setCodec("UTF-8");
+    while (!s.atEnd())
+        use(unescape(s.readLine()));
+    f.close();
+
+    if (oversized())
+        compact();
+}
+
+/** too many stale uses, or distinct entries over the cap by a margin,
+ *  so that rewriting is amortized over many adds
+ */
+bool HistoryStore::oversized() const {
+    if (sequence.size() > 2 * texts.size() + 1000)
+        return true;
+    return max_entries > 0 && texts.size() > max_entries + max_entries / 4 + 100;
+}
+
+/** rewrite newest live entries only, and rebuild the index.
+ *  Sequence positions are renumbered, consoles browsing history restart from newest
+ *  when they see compactions() changed
+ */
+void HistoryStore::compact() {
+    QStringList l = lines_(max_entries > 0 ? max_entries : -1);
+    QSaveFile c(path);
+    if (c.open(c.WriteOnly | c.Text)) {
+        QTextStream t(&c);
+        t.setCodec("UTF-8");
+        foreach (QString x, l)
+            t << escape(x) << '\n';
+        t.flush();
+        if (c.commit()) {
+            texts.clear();
+            stamp.clear();
+            ids.clear();
+            sequence.clear();
+            grams.clear();
+            foreach (QString x, l)
+                use(x);
+            compactions_.fetchAndAddOrdered(1);
+        }
+    }
+}
+
+QString HistoryStore::escape(QString line) {
+    return line.replace("\\", "\\\\").replace("\n", "\\n");
+}
+
+QString HistoryStore::unescape(QString line) {
+    QString r;
+    r.reserve(line.length());
+    for (int i = 0; i < line.length(); ++i)
+        if (line[i] == '\\' && i + 1 < line.length())
+            r.append(line[++i] == 'n' ? QChar('\n') : line[i]);
+        else
+            r.append(line[i]);
+    return r;
+}
+
+/** in memory only: new texts are indexed
+ */
+void HistoryStore::use(QString line) {
+    int seq = sequence.size();
+    auto p = ids.constFind(line);
+    if (p != ids.constEnd()) {
+        stamp[*p] = seq;
+        sequence.append(*p);
+        return;
+    }
+
+    int id = texts.size();
+    texts.append(line);
+    stamp.append(seq);
+    sequence.append(id);
+    ids.insert(line, id);
+
+    QSet<quint64> g;
+    for (int i = 0; i + 3 <= line.length(); ++i)
+        g.insert(gram(line.constData() + i));
+    foreach (quint64 k, g)
+        grams[k].append(id);
+}
+
+void HistoryStore::add(QString line) {
+    QMutexLocker lk(&sync);
+
+    // consecutive repetitions are not recorded
+    if (!sequence.isEmpty() && texts[sequence.last()] == line)
+        return;
+    use(line);
+
+    QFile f(path);
+    if (f.open(f.Append | f.Text))
+        f.write((escape(line) + '\n').toUtf8());
+    else
+        qDebug() << "HistoryStore: can't append to" << path;
+    f.close();
+
+    if (oversized())
+        compact();
+}
+
+int HistoryStore::count() const {
+    QMutexLocker lk(&sync);
+    return sequence.size();
+}
+
+QString HistoryStore::at(int seq) const {
+    QMutexLocker lk(&sync);
+    return seq >= 0 && seq < sequence.size() ? texts[sequence[seq]] : QString();
+}
+
+int HistoryStore::older_(int seq) const {
+    if (seq < 0 || seq > sequence.size())
+        seq = sequence.size();
+    while (--seq >= 0)
+        if (live(seq))
+            return seq;
+    return -1;
+}
+
+int HistoryStore::older(int seq) const {
+    QMutexLocker lk(&sync);
+    return older_(seq);
+}
+
+int HistoryStore::newer(int seq) const {
+    QMutexLocker lk(&sync);
+    while (++seq < sequence.size())
+        if (live(seq))
+            return seq;
+    return -1;
+}
+
+/** candidates are ids in the shortest posting list of text trigrams,
+ *  the newest use among those containing text wins
+ */
+int HistoryStore::find(QString text, int seq) const {
+    QMutexLocker lk(&sync);
+    if (seq < 0 || seq > sequence.size())
+        seq = sequence.size();
+
+    if (text.length() < 3) {
+        for (int p = older_(seq); p >= 0; p = older_(p))
+            if (texts[sequence[p]].contains(text))
+                return p;
+        return -1;
+    }
+
+    const QVector<int> *shortest = 0;
+    for (int i = 0; i + 3 <= text.length(); ++i) {
+        auto p = grams.constFind(gram(text.constData() + i));
+        if (p == grams.constEnd())
+            return -1;
+        if (!shortest || p->size() < shortest->size())
+            shortest = &*p;
+    }
+
+    int found = -1;
+    foreach (int id, *shortest)
+        if (stamp[id] < seq && stamp[id] > found && texts[id].contains(text))
+            found = stamp[id];
+    return found;
+}
+
+QStringList HistoryStore::lines(int max) const {
+    QMutexLocker lk(&sync);
+    return lines_(max);
+}
+
+QStringList HistoryStore::lines_(int max) const {
+    QStringList l;
+    for (int p = older_(-1); p >= 0 && (max < 0 || l.size() < max); p = older_(p))
+        l.prepend(texts[sequence[p]]);
+    return l;
+}
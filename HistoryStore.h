@@ -0,0 +1,107 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include "pqConsole_global.h"
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QStringList>
+
+/** command history, persisted in an append-only file shared by consoles
+ *  each use appends to a sequence; an entry text is stored once (hash dedup),
+ *  and only its latest use is live. A trigram index of entries
+ *  supports incremental reverse search over large histories.
+ */
+class PQCONSOLESHARED_EXPORT HistoryStore {
+public:
+
+    /** the store of the application, loaded on first use */
+    static HistoryStore &shared();
+
+    /** load (and compact if needed) file, that is appended on each add
+     *  at most <max_entries> newest distinct entries are kept (0 = unlimited)
+     */
+    explicit HistoryStore(QString path, int max_entries = 0);
+
+    /** record a use of line, persisting it */
+    void add(QString line);
+
+    /** sequence positions, newest is count() - 1 */
+    int count() const;
+
+    /** text at sequence position */
+    QString at(int seq) const;
+
+    /** live position before (older) or after (newer) <seq>, -1 if none
+     *  seq < 0 means after newest for older(), before oldest for newer()
+     */
+    int older(int seq) const;
+    int newer(int seq) const;
+
+    /** search backward for a live entry containing text, starting before <seq> (-1 = newest) */
+    int find(QString text, int seq = -1) const;
+
+    /** live entries, oldest first, at most <max> newest (max < 0 means all) */
+    QStringList lines(int max = -1) const;
+
+    /** bumped when compaction renumbers sequence positions: held positions are then invalid */
+    int compactions() const { return compactions_.loadAcquire(); }
+
+private:
+    QString path;
+    int max_entries;
+    mutable QMutex sync;
+
+    /** unique texts, and position of their latest use */
+    QStringList texts;
+    QVector<int> stamp;
+    QHash<QString, int> ids;
+
+    /** all uses, as text ids */
+    QVector<int> sequence;
+
+    /** trigram -> ids, in increasing order */
+    QHash<quint64, QVector<int>> grams;
+
+    QAtomicInt compactions_;
+
+    void use(QString line);
+    bool live(int seq) const { return stamp[sequence[seq]] == seq; }
+    int older_(int seq) const;
+    QStringList lines_(int max) const;
+
+    bool oversized() const;
+    void compact();
+
+    static quint64 gram(const QChar *s) {
+        return quint64(s[0].unicode()) << 32 | quint64(s[1].unicode()) << 16 | s[2].unicode();
+    }
+
+    static QString escape(QString line);
+    static QString unescape(QString line);
+};
+
+#endif // HISTORYSTORE_H
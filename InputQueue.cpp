@@ -0,0 +1,94 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "InputQueue.h"
+#include <string.h>
+
+InputQueue::InputQueue(int chunk_size, int max_bytes, int max_pending)
+    : offset(0), ready_bytes(0), text_offset(0), pending_chars(0),
+      chunk_size(chunk_size), max_bytes(max_bytes), max_pending(max_pending)
+{
+}
+
+/** append user input while below <max_pending>, converting a first chunk
+ *  a slice never splits a surrogate pair
+ */
+int InputQueue::append(const QString &text, int from) {
+    int n = qMin(text.length() - from, max_pending - pending());
+    if (n <= 0)
+        return 0;
+    if (from + n < text.length() && text[from + n - 1].isHighSurrogate() && --n == 0)
+        return 0;
+
+    texts.enqueue(from == 0 && n == text.length() ? text : text.mid(from, n));
+    pending_chars += n;
+    refill();
+    return n;
+}
+
+/** copy up to <size> bytes into <buf>, without erasing in front
+ */
+int InputQueue::read(char *buf, int size) {
+    int done = 0;
+    while (done < size && !chunks.isEmpty()) {
+        const QByteArray &c = chunks.head();
+        int n = qMin(size - done, c.size() - offset);
+        memcpy(buf + done, c.constData() + offset, n);
+        done += n;
+        offset += n;
+        ready_bytes -= n;
+        if (offset == c.size()) {
+            chunks.dequeue();
+            offset = 0;
+            refill();
+        }
+    }
+    return done;
+}
+
+void InputQueue::clear() {
+    chunks.clear();
+    texts.clear();
+    offset = ready_bytes = text_offset = pending_chars = 0;
+}
+
+/** convert pending text while below <max_bytes>
+ *  slices never split a surrogate pair
+ */
+void InputQueue::refill() {
+    while (ready_bytes < max_bytes && !texts.isEmpty()) {
+        const QString &t = texts.head();
+        int n = qMin(chunk_size, t.length() - text_offset);
+        if (n > 1 && text_offset + n < t.length() && t[text_offset + n - 1].isHighSurrogate())
+            --n;
+
+        QByteArray c = t.midRef(text_offset, n).toUtf8();
+        ready_bytes += c.size();
+        pending_chars -= n;
+        chunks.enqueue(c);
+
+        if ((text_offset += n) == t.length()) {
+            texts.dequeue();
+            text_offset = 0;
+        }
+    }
+}
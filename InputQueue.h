@@ -0,0 +1,83 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef INPUTQUEUE_H
+#define INPUTQUEUE_H
+
+#include "pqConsole_global.h"
+#include <QQueue>
+#include <QString>
+#include <QByteArray>
+
+/** FIFO of user input, from console to Prolog reader
+ *  Input is appended, never overwritten. Text is converted to UTF-8
+ *  lazily, a chunk at time, as the reader consumes it: a large paste
+ *  costs at most <max_bytes> of converted data beside the original text.
+ *  Pending input is bounded by <max_pending>: append takes what fits,
+ *  and the feeder keeps the rest until the reader drains the queue.
+ *  Not syncronized: owner must lock.
+ */
+class PQCONSOLESHARED_EXPORT InputQueue {
+public:
+
+    explicit InputQueue(int chunk_size = 1 << 16, int max_bytes = 1 << 20, int max_pending = 1 << 22);
+
+    /** append user input from position <from>, as much as fits, return characters taken */
+    int append(const QString &text, int from = 0);
+
+    /** copy up to <size> bytes into <buf>, return count */
+    int read(char *buf, int size);
+
+    /** nothing left to read */
+    bool isEmpty() const { return ready_bytes == 0 && texts.isEmpty(); }
+
+    /** UTF-8 bytes converted and ready to read */
+    int bytes() const { return ready_bytes; }
+
+    /** characters waiting conversion plus bytes ready, bounded by <max_pending> */
+    int pending() const { return pending_chars + ready_bytes; }
+
+    /** below half the bound: a stopped feeder can resume */
+    bool drained() const { return pending() <= max_pending / 2; }
+
+    /** discard everything */
+    void clear();
+
+private:
+
+    /** convert pending text while below <max_bytes> */
+    void refill();
+
+    QQueue<QByteArray> chunks;
+    int offset;         // read position in chunks.head()
+    int ready_bytes;    // unread bytes in chunks
+
+    QQueue<QString> texts;
+    int text_offset;    // conversion position in texts.head()
+    int pending_chars;  // not yet converted in texts
+
+    int chunk_size;
+    int max_bytes;
+    int max_pending;
+};
+
+#endif // INPUTQUEUE_H
@@ -0,0 +1,73 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "OutputRing.h"
+#include <string.h>
+
+OutputRing::OutputRing(int size)
+    : head(0), tail(0)
+{
+    for (capacity = 1024; capacity < size; capacity <<= 1)
+        ;
+    ring = new char[capacity];
+}
+
+OutputRing::~OutputRing() {
+    delete [] ring;
+}
+
+/** bytes waiting for the consumer
+ */
+int OutputRing::available() const {
+    return int(uint(head.loadAcquire()) - uint(tail.loadAcquire()));
+}
+
+/** producer: copy as much as fits, return bytes copied
+ */
+int OutputRing::write(const char *data, int len) {
+    uint h = head.load(), t = tail.loadAcquire();
+    int n = qMin(len, capacity - int(h - t));
+    if (n > 0) {
+        int off = h & (capacity - 1), first = qMin(n, capacity - off);
+        memcpy(ring + off, data, first);
+        memcpy(ring, data + first, n - first);
+        head.storeRelease(int(h + n));
+    }
+    return n;
+}
+
+/** consumer: move out available bytes
+ */
+int OutputRing::read(QByteArray &out, int max) {
+    uint t = tail.load(), h = head.loadAcquire();
+    int n = int(h - t);
+    if (max >= 0 && n > max)
+        n = max;
+    if (n > 0) {
+        int off = t & (capacity - 1), first = qMin(n, capacity - off);
+        out.reserve(out.size() + n);
+        out.append(ring + off, first);
+        out.append(ring, n - first);
+        tail.storeRelease(int(t + n));
+    }
+    return n;
+}
@@ -0,0 +1,74 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef OUTPUTRING_H
+#define OUTPUTRING_H
+
+#include "pqConsole_global.h"
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QMutex>
+
+/** byte ring from Prolog engine (producer) to console (consumer)
+ *  engine appends raw UTF-8, GUI drains in large chunks.
+ *  Consumer side is lock free. Since user_output and user_error
+ *  (and other threads writing there) share the ring, producers
+ *  serialize on <writers>.
+ */
+class PQCONSOLESHARED_EXPORT OutputRing {
+public:
+
+    /** capacity is rounded up to a power of 2 */
+    explicit OutputRing(int capacity = 1 << 20);
+    ~OutputRing();
+
+    /** producer: copy as much as fits, return bytes copied */
+    int write(const char *data, int len);
+
+    /** consumer: append up to <max> (-1 = all) available bytes to <out> */
+    int read(QByteArray &out, int max = -1);
+
+    /** bytes waiting for the consumer */
+    int available() const;
+
+    /** room left to producer */
+    int space() const { return capacity - available(); }
+
+    /** allocated capacity */
+    int size() const { return capacity; }
+
+    /** serialize producers */
+    QMutex writers;
+
+private:
+
+    Q_DISABLE_COPY(OutputRing)
+
+    char *ring;
+    int capacity;
+
+    /** free running counters, masked on access */
+    QAtomicInt head;    // advanced by producer
+    QAtomicInt tail;    // advanced by consumer
+};
+
+#endif // OUTPUTRING_H
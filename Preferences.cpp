@@ -46,6 +46,10 @@ Preferences::Preferences(QObject *parent) :
     console_inp_fore = value("console_inp_fore", 0).toInt();
     console_inp_back = value("console_inp_back", 15).toInt();
 
+    console_scrollback = value("console_scrollback", 0).toInt();
+    console_history = value("console_history", 10000).toInt();
+    engine_pool_size = value("engine_pool_size", 2).toInt();
+
     // selection from SVG named colors
     // see http://www.w3.org/TR/SVG/types.html#ColorKeywords
     static QColor v[] = {
@@ -92,6 +96,10 @@ void Preferences::save() {
     SV(console_inp_fore);
     SV(console_inp_back);
 
+    SV(console_scrollback);
+    SV(console_history);
+    SV(engine_pool_size);
+
     #undef SV
 
     beginWriteArray("ANSI_sequences");
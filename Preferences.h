@@ -57,6 +57,15 @@ public:
     int console_inp_fore;
     int console_inp_back;
 
+    /** max blocks kept in console, older spill to disk (0 = unlimited, the default) */
+    int console_scrollback;
+
+    /** max distinct entries kept in command history file (0 = unlimited) */
+    int console_history;
+
+    /** Prolog engines kept ready for GUI and foreign threads */
+    int engine_pool_size;
+
     /** enable a scroll bar when not wrapped */
     ConsoleEditBase::LineWrapMode wrapMode;
 
@@ -0,0 +1,67 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "PrefixIndex.h"
+#include <algorithm>
+#include <iterator>
+
+void PrefixIndex::insert(QStringList words) {
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    QWriteLocker lk(&lock);
+    QStringList merged;
+    merged.reserve(sorted.size() + words.size());
+    std::set_union(sorted.begin(), sorted.end(), words.begin(), words.end(), std::back_inserter(merged));
+    sorted.swap(merged);
+    ++revision_;
+}
+
+QStringList PrefixIndex::find(QString prefix, int max) const {
+    QReadLocker lk(&lock);
+    QStringList found;
+    for (auto w = std::lower_bound(sorted.begin(), sorted.end(), prefix);
+            w != sorted.end() && w->startsWith(prefix) && found.size() != max; ++w)
+        found.append(*w);
+    return found;
+}
+
+QStringList PrefixIndex::words() const {
+    QReadLocker lk(&lock);
+    return sorted;
+}
+
+int PrefixIndex::size() const {
+    QReadLocker lk(&lock);
+    return sorted.size();
+}
+
+void PrefixIndex::clear() {
+    QWriteLocker lk(&lock);
+    sorted.clear();
+    ++revision_;
+}
+
+int PrefixIndex::revision() const {
+    QReadLocker lk(&lock);
+    return revision_;
+}
@@ -0,0 +1,60 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef PREFIXINDEX_H
+#define PREFIXINDEX_H
+
+#include "pqConsole_global.h"
+#include <QStringList>
+#include <QReadWriteLock>
+
+/** sorted array of unique words, for prefix lookup
+ *  lookup is a binary search plus a scan of matches,
+ *  insertion merges a batch, as when a file has been loaded
+ */
+class PQCONSOLESHARED_EXPORT PrefixIndex {
+public:
+
+    /** merge words, duplicates are ignored */
+    void insert(QStringList words);
+
+    /** words starting with prefix, sorted (max < 0 means all) */
+    QStringList find(QString prefix, int max = -1) const;
+
+    /** all words, sorted */
+    QStringList words() const;
+
+    int size() const;
+    void clear();
+
+    /** changes on each insert or clear, to validate derived data */
+    int revision() const;
+
+    PrefixIndex() : revision_(0) {}
+
+private:
+    mutable QReadWriteLock lock;
+    QStringList sorted;
+    int revision_;
+};
+
+#endif // PREFIXINDEX_H
@@ -0,0 +1,193 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "PrologLexer.h"
+
+/** compile time classification of ASCII characters */
+static constexpr unsigned char cc(int c) {
+    return  c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v' ? PrologLexer::Space :
+            c >= 'a' && c <= 'z' ? PrologLexer::Lower :
+            c >= 'A' && c <= 'Z' ? PrologLexer::Upper :
+            c == '_' ? PrologLexer::Under :
+            c >= '0' && c <= '9' ? PrologLexer::Digit :
+            c == '%' ? PrologLexer::Percent :
+            c == '\'' ? PrologLexer::Quote :
+            c == '"' ? PrologLexer::DQuote :
+            c == '`' ? PrologLexer::BQuote :
+            c == ',' || c == ';' || c == '|' || c == '{' || c == '}' ? PrologLexer::Solo :
+            c == '(' || c == ')' || c == '[' || c == ']' || c == '!' ? PrologLexer::Punct :
+            c == '#' || c == '$' || c == '&' || c == '*' || c == '+' || c == '-' || c == '.' || c == '/' ||
+            c == ':' || c == '<' || c == '=' || c == '>' || c == '?' || c == '@' || c == '^' || c == '~' ||
+            c == '\\' ? PrologLexer::Symbol :
+            PrologLexer::Other;
+}
+
+#define R8(b) cc(b), cc(b+1), cc(b+2), cc(b+3), cc(b+4), cc(b+5), cc(b+6), cc(b+7)
+const unsigned char PrologLexer::ascii[128] = {
+    R8(0),  R8(8),  R8(16), R8(24), R8(32), R8(40), R8(48), R8(56),
+    R8(64), R8(72), R8(80), R8(88), R8(96), R8(104), R8(112), R8(120)
+};
+#undef R8
+
+/** inside a block comment: track nesting, depth is 0 when closed
+ */
+int PrologLexer::comment(const QChar *s, int n, int i, int &depth) {
+    while (i < n) {
+        if (s[i] == '/' && i + 1 < n && s[i + 1] == '*') {
+            ++depth;
+            i += 2;
+        }
+        else if (s[i] == '*' && i + 1 < n && s[i + 1] == '/') {
+            i += 2;
+            if (--depth == 0)
+                return i;
+        }
+        else
+            ++i;
+    }
+    return n;
+}
+
+/** after opening quote <q>: escapes and doubled quotes, a line can continue
+ */
+int PrologLexer::quoted(const QChar *s, int n, int i, QChar q, bool &closed) {
+    while (i < n) {
+        if (s[i] == '\\')
+            i = escape(s, n, i + 1);
+        else if (s[i] == q) {
+            if (i + 1 < n && s[i + 1] == q)
+                i += 2;
+            else {
+                closed = true;
+                return i + 1;
+            }
+        }
+        else
+            ++i;
+    }
+    closed = false;
+    return n;
+}
+
+/** after a backslash: \xHH..\ \NNN\ \uXXXX \UXXXXXXXX or a single char
+ */
+int PrologLexer::escape(const QChar *s, int n, int i) {
+    if (i >= n)
+        return n;
+    int j;
+    switch (s[i].unicode()) {
+    case 'x':
+        j = digits(s, n, i + 1, 16);
+        return j < n && s[j] == '\\' ? j + 1 : j;
+    case 'u':
+        return qMin(n, i + 5);
+    case 'U':
+        return qMin(n, i + 9);
+    default:
+        if (s[i] >= '0' && s[i] <= '7') {
+            j = digits(s, n, i, 8);
+            return j < n && s[j] == '\\' ? j + 1 : j;
+        }
+        return i + 1;
+    }
+}
+
+int PrologLexer::digit_value(QChar c) {
+    ushort u = c.unicode();
+    if (u >= '0' && u <= '9')
+        return u - '0';
+    if (u >= 'a' && u <= 'z')
+        return u - 'a' + 10;
+    if (u >= 'A' && u <= 'Z')
+        return u - 'A' + 10;
+    return 99;
+}
+
+/** digits in <base>, single _ allowed between digits
+ */
+int PrologLexer::digits(const QChar *s, int n, int i, int base) {
+    while (i < n) {
+        if (digit_value(s[i]) < base)
+            ++i;
+        else if (s[i] == '_' && i + 1 < n && digit_value(s[i + 1]) < base)
+            i += 2;
+        else
+            break;
+    }
+    return i;
+}
+
+/** integers (0x 0o 0b, Radix'digits), floats with exponent, Inf/NaN, 0'c
+ */
+int PrologLexer::number(const QChar *s, int n, int i, token &t) {
+    t = Number;
+    if (s[i] == '0' && i + 1 < n) {
+        ushort c = s[i + 1].unicode();
+        if (c == '\'') {
+            t = CharCode;
+            int j = i + 2;
+            if (j >= n)
+                return j;
+            if (s[j] == '\\')
+                return escape(s, n, j + 1);
+            if (s[j] == '\'' && j + 1 < n && s[j + 1] == '\'')
+                return j + 2;
+            return j + 1;
+        }
+        int base = c == 'x' ? 16 : c == 'o' ? 8 : c == 'b' ? 2 : 0;
+        if (base && i + 2 < n && digit_value(s[i + 2]) < base)
+            return digits(s, n, i + 2, base);
+    }
+
+    int j = digits(s, n, i, 10);
+
+    // Radix'digits
+    if (j < n && s[j] == '\'' && j - i <= 2) {
+        int base = 0;
+        for (int k = i; k < j; ++k)
+            base = base * 10 + digit_value(s[k]);
+        if (base >= 2 && base <= 36 && j + 1 < n && digit_value(s[j + 1]) < base)
+            return digits(s, n, j + 1, base);
+        return j;
+    }
+
+    bool is_float = false;
+    if (j + 1 < n && s[j] == '.' && digit_value(s[j + 1]) < 10) {
+        j = digits(s, n, j + 1, 10);
+        is_float = true;
+    }
+    if (j < n && (s[j] == 'e' || s[j] == 'E')) {
+        int k = j + 1;
+        if (k < n && (s[k] == '+' || s[k] == '-'))
+            ++k;
+        if (k < n && digit_value(s[k]) < 10) {
+            j = digits(s, n, k, 10);
+            is_float = true;
+        }
+    }
+    if (is_float && j + 3 <= n) {
+        QString tail(s + j, 3);
+        if (tail == "Inf" || tail == "NaN")
+            j += 3;
+    }
+    return j;
+}
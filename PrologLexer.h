@@ -0,0 +1,172 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef PROLOGLEXER_H
+#define PROLOGLEXER_H
+
+#include "pqConsole_global.h"
+#include <QString>
+
+/** line oriented Prolog lexer, for highlighting
+ *  Dispatch is on character classes from a table computed at compile time.
+ *  Constructs spanning lines (block comments, possibly nested, and quoted
+ *  items) are carried in an integer state, suitable for currentBlockState().
+ */
+struct PQCONSOLESHARED_EXPORT PrologLexer {
+
+    enum token {
+        Comment,
+        Atom,
+        Atomq,
+        Atombackq,
+        String,
+        Variable,
+        Number,
+        Operator,
+        CharCode,
+        Unknown
+    };
+
+    /** character classes */
+    enum cclass {
+        Other, Space, Lower, Upper, Under, Digit, Symbol, Solo, Punct, Quote, DQuote, BQuote, Percent
+    };
+
+    /** ASCII classes, non ASCII letters are classified by case */
+    static const unsigned char ascii[128];
+    static cclass classify(QChar c) {
+        ushort u = c.unicode();
+        if (u < 128)
+            return cclass(ascii[u]);
+        return c.isUpper() ? Upper : c.isLetter() ? Lower : c.isDigit() ? Digit : c.isSpace() ? Space : Other;
+    }
+
+    /** state at end of line: 0 when nothing is open */
+    enum { in_comment = 1, in_quote = 2, in_dquote = 3, in_bquote = 4 };
+
+    /** scan <text>, starting from <state> of previous line (negative means none)
+     *  call span(start, length, token) for each highlighted item, return state at end
+     */
+    template <class Span>
+    static int lex(const QString &text, int state, Span span);
+
+    /** helpers: return position after the construct */
+    static int comment(const QChar *s, int n, int i, int &depth);
+    static int quoted(const QChar *s, int n, int i, QChar q, bool &closed);
+    static int number(const QChar *s, int n, int i, token &t);
+    static int escape(const QChar *s, int n, int i);
+    static int digits(const QChar *s, int n, int i, int base);
+    static int digit_value(QChar c);
+};
+
+template <class Span>
+int PrologLexer::lex(const QString &text, int state, Span span) {
+    const QChar *s = text.constData();
+    const int n = text.length();
+    int i = 0, j, depth;
+    bool closed;
+
+    // resume constructs open on previous lines
+    switch (state < 0 ? 0 : state & 0xF) {
+    case in_comment:
+        depth = state >> 4;
+        i = comment(s, n, 0, depth);
+        span(0, i, Comment);
+        if (depth)
+            return in_comment | (depth << 4);
+        break;
+    case in_quote:
+    case in_dquote:
+    case in_bquote: {
+        static const char q[] = "  '\"`";
+        static const token t[] = { Unknown, Unknown, Atomq, String, Atombackq };
+        int k = state & 0xF;
+        i = quoted(s, n, 0, QLatin1Char(q[k]), closed);
+        span(0, i, t[k]);
+        if (!closed)
+            return k;
+        break;
+    }
+    }
+
+    while (i < n) {
+        token t;
+        switch (classify(s[i])) {
+        case Percent:
+            span(i, n - i, Comment);
+            return 0;
+        case Lower:
+            for (j = i + 1; j < n && classify(s[j]) >= Lower && classify(s[j]) <= Digit; ++j) ;
+            span(i, j - i, Atom);
+            break;
+        case Upper:
+        case Under:
+            for (j = i + 1; j < n && classify(s[j]) >= Lower && classify(s[j]) <= Digit; ++j) ;
+            span(i, j - i, Variable);
+            break;
+        case Digit:
+            j = number(s, n, i, t);
+            span(i, j - i, t);
+            break;
+        case Quote:
+            j = quoted(s, n, i + 1, s[i], closed);
+            span(i, j - i, Atomq);
+            if (!closed)
+                return in_quote;
+            break;
+        case DQuote:
+            j = quoted(s, n, i + 1, s[i], closed);
+            span(i, j - i, String);
+            if (!closed)
+                return in_dquote;
+            break;
+        case BQuote:
+            j = quoted(s, n, i + 1, s[i], closed);
+            span(i, j - i, Atombackq);
+            if (!closed)
+                return in_bquote;
+            break;
+        case Symbol:
+            if (s[i] == '/' && i + 1 < n && s[i + 1] == '*') {
+                depth = 1;
+                j = comment(s, n, i + 2, depth);
+                span(i, j - i, Comment);
+                if (depth)
+                    return in_comment | (depth << 4);
+                break;
+            }
+            for (j = i + 1; j < n && classify(s[j]) == Symbol && !(s[j] == '/' && j + 1 < n && s[j + 1] == '*'); ++j) ;
+            span(i, j - i, Operator);
+            break;
+        case Solo:
+            j = i + 1;
+            span(i, 1, Operator);
+            break;
+        default:
+            j = i + 1;
+        }
+        i = j;
+    }
+    return 0;
+}
+
+#endif // PROLOGLEXER_H
@@ -0,0 +1,199 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "QueryScheduler.h"
+#include "SwiPrologEngine.h"
+#include "EnginePool.h"
+#include <QThread>
+#include <QtDebug>
+#include <string.h>
+
+/** a Prolog thread serving its deque
+ */
+class QueryScheduler::worker : public QThread {
+public:
+    worker(int index) : index(index) {}
+
+    int index;
+
+    /** ordered by priority, FIFO among equals */
+    QMutex sync;
+    QList<job> deque;
+
+    void push(const job &j) {
+        QMutexLocker lk(&sync);
+        int p = 0;
+        while (p < deque.size() && deque[p].priority >= j.priority)
+            ++p;
+        deque.insert(p, j);
+    }
+
+protected:
+    virtual void run();
+};
+
+QMutex QueryScheduler::sync;
+QWaitCondition QueryScheduler::park;
+QList<QueryScheduler::worker*> QueryScheduler::pool;
+int QueryScheduler::workers_;
+bool QueryScheduler::stopping;
+QAtomicInt QueryScheduler::pending_;
+QAtomicInt QueryScheduler::next;
+
+int QueryScheduler::workers() {
+    QMutexLocker lk(&sync);
+    return workers_ > 0 ? workers_ : qMax(1, QThread::idealThreadCount());
+}
+
+void QueryScheduler::set_workers(int n) {
+    QMutexLocker lk(&sync);
+    workers_ = n;
+}
+
+pqQueryPtr QueryScheduler::submit(QString goal, QString module, int priority, affinity where, int batch_size, int limit) {
+    pqQueryPtr h(new pqQuery(goal, module, batch_size, limit), &QObject::deleteLater);
+    submit(h, priority, where);
+    return h;
+}
+
+/** queries submitted from a worker stay local, others go round robin
+ */
+void QueryScheduler::submit(pqQueryPtr h, int priority, affinity where) {
+    if (where == console_thread) {
+        Q_ASSERT(SwiPrologEngine::spe);
+        SwiPrologEngine::spe->query_solutions(h);
+        return;
+    }
+
+    start();
+
+    worker *w = 0;
+    {   QMutexLocker lk(&sync);
+        foreach (worker *t, pool)
+            if (t == QThread::currentThread())
+                w = t;
+        if (!w)
+            w = pool[unsigned(next.fetchAndAddRelaxed(1)) % pool.size()];
+    }
+
+    job j = { h, priority };
+    w->push(j);
+    pending_.ref();
+
+    QMutexLocker lk(&sync);
+    park.wakeOne();
+}
+
+/** create worker threads once
+ */
+void QueryScheduler::start() {
+    QMutexLocker lk(&sync);
+    if (!pool.isEmpty())
+        return;
+    int n = workers_ > 0 ? workers_ : qMax(1, QThread::idealThreadCount());
+    for (int i = 0; i < n; ++i) {
+        worker *w = new worker(i);
+        pool.append(w);
+        w->start();
+    }
+}
+
+void QueryScheduler::shutdown() {
+    QMutexLocker lk(&sync);
+    stopping = true;
+    park.wakeAll();
+}
+
+/** own deque first, else steal the most urgent head among others
+ */
+bool QueryScheduler::take(int index, job &j) {
+    QList<worker*> ws;
+    {   QMutexLocker lk(&sync);
+        ws = pool;
+    }
+
+    worker *self = ws[index];
+    {   QMutexLocker lk(&self->sync);
+        if (!self->deque.isEmpty()) {
+            j = self->deque.takeFirst();
+            pending_.deref();
+            return true;
+        }
+    }
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        worker *victim = 0;
+        int best = 0;
+        for (int i = 1; i < ws.size(); ++i) {
+            worker *w = ws[(index + i) % ws.size()];
+            QMutexLocker lk(&w->sync);
+            if (!w->deque.isEmpty() && (!victim || w->deque.first().priority > best)) {
+                victim = w;
+                best = w->deque.first().priority;
+            }
+        }
+        if (!victim)
+            return false;
+
+        QMutexLocker lk(&victim->sync);
+        if (!victim->deque.isEmpty()) {
+            j = victim->deque.takeFirst();
+            pending_.deref();
+            return true;
+        }
+    }
+    return false;
+}
+
+/** attach a Prolog thread, then serve queries til shutdown
+ */
+void QueryScheduler::worker::run() {
+    while (!EnginePool::is_ready())
+        msleep(100);
+
+    PL_thread_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.flags = PL_THREAD_NO_DEBUG;
+    QByteArray alias = "_pq_worker_" + QByteArray::number(index);
+    attr.alias = alias.data();
+
+    if (PL_thread_attach_engine(&attr) < 0) {
+        qDebug() << "QueryScheduler: PL_thread_attach_engine failed" << index;
+        return;
+    }
+
+    for ( ; ; ) {
+        job j;
+        if (take(index, j)) {
+            j.q->run();
+            continue;
+        }
+
+        QMutexLocker lk(&QueryScheduler::sync);
+        if (stopping)
+            break;
+        if (pending_.loadAcquire() == 0)
+            park.wait(&QueryScheduler::sync);
+    }
+
+    PL_thread_destroy_engine();
+}
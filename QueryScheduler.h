@@ -0,0 +1,85 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef QUERYSCHEDULER_H
+#define QUERYSCHEDULER_H
+
+#include "pqQuery.h"
+#include <QMutex>
+#include <QAtomicInt>
+#include <QWaitCondition>
+
+/** dispatch independent queries to worker Prolog threads
+ *  Each worker owns a deque ordered by priority, and when it runs dry
+ *  steals the most urgent query from the other workers.
+ *  Queries that must see the console toplevel state go to SwiPrologEngine queue.
+ */
+class PQCONSOLESHARED_EXPORT QueryScheduler {
+public:
+
+    /** where a query can run */
+    enum affinity {
+        any_worker,     // first available worker thread
+        console_thread  // main console thread, when it's waiting for input
+    };
+
+    /** queue a query, higher priority runs first (among workers only)
+     *  connect to the handle signals before control returns to event loop
+     */
+    static pqQueryPtr submit(QString goal, QString module = QString(),
+                             int priority = 0, affinity where = any_worker,
+                             int batch_size = 100, int limit = 0);
+    static void submit(pqQueryPtr h, int priority = 0, affinity where = any_worker);
+
+    /** workers count, effective when they are started (on first submit) */
+    static int workers();
+    static void set_workers(int n);
+
+    /** queued, not yet running */
+    static int pending() { return pending_.loadAcquire(); }
+
+    /** let workers exit when idle */
+    static void shutdown();
+
+private:
+
+    class worker;
+    friend class worker;
+
+    struct job {
+        pqQueryPtr q;
+        int priority;
+    };
+
+    static void start();
+    static bool take(int index, job &j);
+
+    static QMutex sync;         // workers list and parking
+    static QWaitCondition park; // idle workers wait here
+    static QList<worker*> pool;
+    static int workers_;
+    static bool stopping;
+    static QAtomicInt pending_;
+    static QAtomicInt next;     // round robin target
+};
+
+#endif // QUERYSCHEDULER_H
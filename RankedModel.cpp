@@ -0,0 +1,46 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "RankedModel.h"
+
+void RankedModel::rank(QString pattern, int max) {
+    beginResetModel();
+    if (pattern.isEmpty()) {
+        int n = qMin(max, matcher.candidates().size());
+        rows.resize(n);
+        for (int i = 0; i < n; ++i)
+            rows[i] = i;
+    }
+    else
+        rows = matcher.rank(pattern, max);
+    endResetModel();
+}
+
+int RankedModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : rows.size();
+}
+
+QVariant RankedModel::data(const QModelIndex &index, int role) const {
+    if (index.isValid() && index.row() < rows.size() && (role == Qt::DisplayRole || role == Qt::EditRole))
+        return matcher.candidates()[rows[index.row()]];
+    return QVariant();
+}
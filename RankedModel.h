@@ -0,0 +1,51 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef RANKEDMODEL_H
+#define RANKEDMODEL_H
+
+#include "FuzzyMatcher.h"
+#include <QAbstractListModel>
+
+/** view on FuzzyMatcher candidates, in rank order
+ *  keeps only indices: nothing is copied when the ranking changes
+ */
+class PQCONSOLESHARED_EXPORT RankedModel : public QAbstractListModel {
+    Q_OBJECT
+public:
+
+    RankedModel(QObject *parent = 0) : QAbstractListModel(parent) {}
+
+    /** candidates and scoring */
+    FuzzyMatcher matcher;
+
+    /** rank candidates for pattern, reset the view */
+    void rank(QString pattern, int max = 1000);
+
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+private:
+    QVector<int> rows;
+};
+
+#endif // RANKEDMODEL_H
@@ -0,0 +1,98 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "ScrollbackLog.h"
+#include <QDir>
+#include <QDebug>
+
+ScrollbackLog::ScrollbackLog()
+    : file(QDir::tempPath() + "/pqConsole_scrollback_XXXXXX.log"),
+      end(0)
+{
+}
+
+/** append evicted lines, oldest first
+ */
+bool ScrollbackLog::append(const QStringList &lines) {
+    if (!file.isOpen() && !file.open()) {
+        qDebug() << "ScrollbackLog: can't open" << file.fileName();
+        return false;
+    }
+
+    QByteArray data;
+    offsets.reserve(offsets.size() + lines.size());
+    foreach (QString l, lines) {
+        offsets.append(end + data.size());
+        data.append(l.toUtf8()).append('\n');
+    }
+
+    if (!file.seek(end) || file.write(data) != data.size()) {
+        offsets.resize(offsets.size() - lines.size());
+        return false;
+    }
+    end += data.size();
+    return true;
+}
+
+/** read back <n> lines starting at <first>
+ */
+QStringList ScrollbackLog::lines(int first, int n) {
+    QStringList r;
+    first = qBound(0, first, count());
+    n = qBound(0, n, count() - first);
+    if (n > 0 && file.seek(offsets[first])) {
+        qint64 stop = first + n < count() ? offsets[first + n] : end;
+        QByteArray data = file.read(stop - offsets[first]);
+        for (int p = 0, q; (q = data.indexOf('\n', p)) >= 0; p = q + 1)
+            r.append(QString::fromUtf8(data.constData() + p, q - p));
+    }
+    return r;
+}
+
+/** search backward (toward older lines) from <from>, a page at time
+ */
+int ScrollbackLog::find(QString text, int from, Qt::CaseSensitivity cs) {
+    const int page = 1024;
+    if (from < 0 || from >= count())
+        from = count() - 1;
+    for (int last = from; last >= 0; last -= page) {
+        int first = qMax(0, last - page + 1);
+        QStringList l = lines(first, last - first + 1);
+        for (int i = l.size() - 1; i >= 0; --i)
+            if (l[i].contains(text, cs))
+                return first + i;
+    }
+    return -1;
+}
+
+/** detach newest <n> lines, truncating the file
+ */
+QStringList ScrollbackLog::take_last(int n) {
+    n = qBound(0, n, count());
+    QStringList r = lines(count() - n, n);
+    if (n > 0) {
+        end = offsets[count() - n];
+        offsets.resize(count() - n);
+        file.resize(end);
+    }
+    return r;
+}
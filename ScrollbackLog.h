@@ -0,0 +1,66 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SCROLLBACKLOG_H
+#define SCROLLBACKLOG_H
+
+#include "pqConsole_global.h"
+#include <QVector>
+#include <QStringList>
+#include <QTemporaryFile>
+
+/** append-only on disk store of text lines evicted from a console
+ *  a line-offset index allows paging and searching old output
+ *  without keeping it in the document.
+ */
+class PQCONSOLESHARED_EXPORT ScrollbackLog {
+public:
+
+    ScrollbackLog();
+
+    /** append evicted lines, oldest first */
+    bool append(const QStringList &lines);
+
+    /** number of lines available */
+    int count() const { return offsets.size(); }
+
+    /** read back <n> lines starting at <first> */
+    QStringList lines(int first, int n);
+
+    /** search backward (toward older lines) from <from> (-1 = newest), -1 if not found */
+    int find(QString text, int from = -1, Qt::CaseSensitivity cs = Qt::CaseSensitive);
+
+    /** detach newest <n> lines, to page them back in the document */
+    QStringList take_last(int n);
+
+private:
+
+    QTemporaryFile file;
+
+    /** start of each line in file */
+    QVector<qint64> offsets;
+
+    /** logical end of file */
+    qint64 end;
+};
+
+#endif // SCROLLBACKLOG_H
@@ -0,0 +1,222 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "SemanticColour.h"
+#include "SwiPrologEngine.h"
+#include "PrologLexer.h"
+#include "PREDICATE.h"
+#include <QMutex>
+#include <QDebug>
+
+/** scan line by line, as done for highlighting, cutting after each full stop
+ */
+SemanticColour::clauses SemanticColour::split(const QString &text) {
+    clauses cl;
+    int start = 0, state = 0;
+    bool code = false;
+
+    for (int line = 0; line <= text.length(); ) {
+        int eol = text.indexOf('\n', line);
+        if (eol < 0)
+            eol = text.length();
+
+        state = PrologLexer::lex(text.mid(line, eol - line), state, [&](int s, int l, PrologLexer::token t) {
+            if (t != PrologLexer::Comment)
+                code = true;
+            int p = line + s;
+            if (t == PrologLexer::Operator && l == 1 && text[p] == '.' &&
+                    (p + 1 == text.length() || text[p + 1].isSpace() || text[p + 1] == '%')) {
+                if (code) {
+                    clause c = { start, p + 1 - start, text.mid(start, p + 1 - start) };
+                    cl.append(c);
+                }
+                start = p + 1;
+                code = false;
+            }
+        });
+        line = eol + 1;
+    }
+
+    // unterminated: still useful, to get syntax errors
+    if (code) {
+        clause c = { start, text.length() - start, text.mid(start) };
+        cl.append(c);
+    }
+    return cl;
+}
+
+/** convert list of f(Start, Length, Class)
+ */
+static SemanticColour::fragments read_fragments(PlTerm list) {
+    SemanticColour::fragments f;
+    PlTerm F;
+    for (PlTail l(list); l.next(F); ) {
+        SemanticColour::fragment x = { int(long(F[1])), int(long(F[2])), SemanticColour::class_index(t2w(F[3])) };
+        f.append(x);
+    }
+    return f;
+}
+
+void SemanticColour::colourise(const QString &text, const clauses &cl, QString source) {
+    SwiPrologEngine::in_thread e;
+    if (!e.resource_module("pq_colour"))
+        return;
+
+    try {
+        PlAtom Source = A(source);
+        PlTerm Stamp;
+        PlCall("pq_colour", "pq_colour_prepare", PlTermv(PlTerm(Source), Stamp));
+
+        // classes as goal_undefined or head_unreferenced depend on xref data:
+        // when it has been rebuilt, cached clauses are stale
+        double stamp = double(Stamp);
+        {   QWriteLocker lk(&lock);
+            if (stamp != xref_stamp) {
+                xref_stamp = stamp;
+                cache.clear();
+            }
+        }
+
+        foreach (clause c, cl) {
+            fragments f;
+            if (find(c.text, f))
+                continue;
+
+            PlFrame fr;
+            PlTerm Fragments;
+            if (PlCall("pq_colour", "pq_colour_clause", PlTermv(PlString(c.text.toStdWString().data()), PlTerm(Source), Fragments)))
+                f = read_fragments(Fragments);
+
+            QWriteLocker lk(&lock);
+            cache.insert(c.text, f);
+        }
+    }
+    catch(PlException e) {
+        qDebug() << t2w(e);
+    }
+}
+
+SemanticColour::fragments SemanticColour::colourise_query(QString text) {
+    fragments f;
+    SwiPrologEngine::in_thread e;
+    if (!e.resource_module("pq_colour"))
+        return f;
+
+    try {
+        PlTerm Fragments;
+        if (PlCall("pq_colour", "pq_colour_query", PlTermv(PlString(text.toStdWString().data()), Fragments)))
+            f = read_fragments(Fragments);
+    }
+    catch(PlException e) {
+        qDebug() << t2w(e);
+    }
+    return f;
+}
+
+bool SemanticColour::find(const QString &text, fragments &f) const {
+    QReadLocker lk(&lock);
+    auto p = cache.constFind(text);
+    if (p == cache.constEnd())
+        return false;
+    f = *p;
+    return true;
+}
+
+void SemanticColour::set_pass(int generation, const clauses &cl) {
+    QWriteLocker lk(&lock);
+    last_pass = cl;
+    pass_generation = generation;
+}
+
+SemanticColour::clauses SemanticColour::pass(int generation) const {
+    QReadLocker lk(&lock);
+    return generation == pass_generation ? last_pass : clauses();
+}
+
+static QMutex classes_sync;
+static QStringList classes;
+static QHash<QString, int> classes_index;
+
+int SemanticColour::class_index(QString name) {
+    QMutexLocker lk(&classes_sync);
+    auto p = classes_index.constFind(name);
+    if (p != classes_index.constEnd())
+        return *p;
+    classes.append(name);
+    return classes_index[name] = classes.size() - 1;
+}
+
+QString SemanticColour::class_name(int cls) {
+    QMutexLocker lk(&classes_sync);
+    return classes.value(cls);
+}
+
+const QHash<QString, QTextCharFormat> &SemanticColour::formats() {
+    static QHash<QString, QTextCharFormat> f;
+    static QMutex sync;
+    QMutexLocker lk(&sync);
+
+    if (f.isEmpty()) {
+        QTextCharFormat bold;
+        bold.setFontWeight(QFont::Bold);
+
+        f["head_exported"] = bold;
+        f["head_exported"].setForeground(Qt::blue);
+        f["head_public"] = bold;
+        f["head_local"] = bold;
+        f["head_dynamic"] = bold;
+        f["head_dynamic"].setForeground(Qt::magenta);
+        f["head_multifile"] = bold;
+        f["head_multifile"].setForeground(Qt::darkCyan);
+        f["head_unreferenced"] = bold;
+        f["head_unreferenced"].setForeground(Qt::red);
+
+        f["goal_built_in"].setForeground(QColor("navy"));
+        f["goal_autoload"].setForeground(QColor("navy"));
+        f["goal_imported"].setForeground(Qt::blue);
+        f["goal_global"].setForeground(Qt::darkCyan);
+        f["goal_dynamic"].setForeground(Qt::magenta);
+        f["goal_undefined"].setForeground(Qt::red);
+        f["goal_recursion"].setFontUnderline(true);
+
+        f["singleton"] = bold;
+        f["singleton"].setForeground(Qt::red);
+        f["neck"] = bold;
+        f["fullstop"] = bold;
+
+        f["syntax_error"].setUnderlineColor(Qt::red);
+        f["syntax_error"].setUnderlineStyle(QTextCharFormat::WaveUnderline);
+    }
+    return f;
+}
+
+int SemanticColour::size() const {
+    QReadLocker lk(&lock);
+    return cache.size();
+}
+
+void SemanticColour::clear() {
+    QWriteLocker lk(&lock);
+    cache.clear();
+    last_pass.clear();
+    pass_generation = -1;
+}
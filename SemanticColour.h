@@ -0,0 +1,95 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SEMANTICCOLOUR_H
+#define SEMANTICCOLOUR_H
+
+#include "pqConsole_global.h"
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+#include <QReadWriteLock>
+#include <QAtomicInt>
+#include <QTextCharFormat>
+
+/** results of SWI-Prolog prolog_colourise_term/4, cached per clause
+ *  the key is the clause text, so only changed clauses are colourised again.
+ *  The cache is dropped when cross reference data of source is rebuilt.
+ *  Colourising runs Prolog: call from a worker thread, it binds a pooled engine
+ */
+class PQCONSOLESHARED_EXPORT SemanticColour {
+public:
+
+    /** a classified range, start relative to clause, class interned by class_index */
+    struct fragment {
+        int start, length, cls;
+        bool operator==(const fragment &f) const { return start == f.start && length == f.length && cls == f.cls; }
+    };
+    typedef QVector<fragment> fragments;
+
+    /** a clause in text */
+    struct clause {
+        int start, length;
+        QString text;
+    };
+    typedef QVector<clause> clauses;
+
+    /** split text at full stops, comments only text is skipped */
+    static clauses split(const QString &text);
+
+    /** colourise clauses not yet cached, with cross reference data of source (a file name) */
+    void colourise(const QString &text, const clauses &cl, QString source);
+
+    /** colourise a toplevel query (not cached) */
+    static fragments colourise_query(QString text);
+
+    /** lookup cached */
+    bool find(const QString &text, fragments &f) const;
+
+    /** last split, tagged by the generation of the snapshot it came from */
+    void set_pass(int generation, const clauses &cl);
+    clauses pass(int generation) const;
+
+    /** class names, as 'goal_built_in', 'head_exported', 'singleton' */
+    static int class_index(QString name);
+    static QString class_name(int cls);
+
+    /** default presentation, by class name, classes not listed are left to the lexer */
+    static const QHash<QString, QTextCharFormat> &formats();
+
+    int size() const;
+    void clear();
+
+    /** document snapshot being colourised, bumped on each new snapshot */
+    QAtomicInt generation;
+
+    SemanticColour() : pass_generation(-1), xref_stamp(-1) {}
+
+private:
+    mutable QReadWriteLock lock;
+    QHash<QString, fragments> cache;
+    clauses last_pass;
+    int pass_generation;
+    double xref_stamp;
+};
+
+#endif // SEMANTICCOLOUR_H
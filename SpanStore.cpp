@@ -0,0 +1,98 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "SpanStore.h"
+#include <algorithm>
+
+bool SpanStore::find(const QString &text, int state_in, line &l) const {
+    QReadLocker lk(&lock);
+    key k(text, state_in);
+    auto p = lines.constFind(k);
+    if (p == lines.constEnd()) {
+        p = previous.constFind(k);
+        if (p == previous.constEnd())
+            return false;
+    }
+    l = *p;
+    return true;
+}
+
+SpanStore::line SpanStore::lex(const QString &text, int state_in) {
+    line l;
+    key k(text, state_in);
+    bool known;
+    {   QReadLocker lk(&lock);
+        auto p = lines.constFind(k);
+        if (p != lines.constEnd())
+            return *p;
+        p = previous.constFind(k);
+        if ((known = p != previous.constEnd()))
+            l = *p;
+    }
+
+    if (!known) {
+        l.state_out = PrologLexer::lex(text, state_in, [&l](int start, int length, PrologLexer::token t) {
+            l.spans.append(quint64(start) << 32 | quint64(length) << 4 | t);
+        });
+        l.spans.squeeze();
+    }
+
+    QWriteLocker lk(&lock);
+    if (lines.size() >= max_lines) {
+        previous.swap(lines);
+        lines.clear();
+    }
+    lines.insert(k, l);
+    return l;
+}
+
+void SpanStore::set_states(int generation, int first, const QVector<int> &chunk) {
+    QWriteLocker lk(&lock);
+    if (generation != states_generation) {
+        states.clear();
+        states_generation = generation;
+    }
+    states.resize(first + chunk.size());
+    std::copy(chunk.begin(), chunk.end(), states.begin() + first);
+}
+
+/** -1 when not (yet) known for this snapshot
+ */
+int SpanStore::state_at(int generation, int line_number) const {
+    QReadLocker lk(&lock);
+    if (generation != states_generation || line_number >= states.size())
+        return -1;
+    return states[line_number];
+}
+
+int SpanStore::size() const {
+    QReadLocker lk(&lock);
+    return lines.size() + previous.size();
+}
+
+void SpanStore::clear() {
+    QWriteLocker lk(&lock);
+    lines.clear();
+    previous.clear();
+    states.clear();
+    states_generation = -1;
+}
@@ -0,0 +1,81 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SPANSTORE_H
+#define SPANSTORE_H
+
+#include "pqConsole_global.h"
+#include "PrologLexer.h"
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include <QReadWriteLock>
+#include <QAtomicInt>
+
+/** lexer results per line, shared between GUI and a lexing worker
+ *  a line result depends only on its text and entry state, and is keyed by these
+ *  (the text is compared, not only hashed), so it survives lines insertion/removal,
+ *  and identical lines share storage.
+ *  Size is bounded on insert: when <max_lines> are stored, current results
+ *  become the previous generation, and a hit there moves the line back (approximate LRU)
+ */
+class PQCONSOLESHARED_EXPORT SpanStore {
+public:
+
+    /** a span packs start << 32 | length << 4 | token */
+    struct line {
+        int state_out;
+        QVector<quint64> spans;
+    };
+
+    static int span_start(quint64 s) { return int(s >> 32); }
+    static int span_length(quint64 s) { return int(quint32(s) >> 4); }
+    static PrologLexer::token span_token(quint64 s) { return PrologLexer::token(s & 0xF); }
+
+    /** lookup a previous result */
+    bool find(const QString &text, int state_in, line &l) const;
+
+    /** lookup or lex and store */
+    line lex(const QString &text, int state_in);
+
+    /** entry states of a document snapshot, tagged by generation, published in chunks while lexing */
+    void set_states(int generation, int first, const QVector<int> &chunk);
+    int state_at(int generation, int line_number) const;
+
+    int size() const;
+    void clear();
+
+    /** document snapshot being lexed, bumped on each new snapshot */
+    QAtomicInt generation;
+
+    explicit SpanStore(int max_lines = 50000) : max_lines(max_lines), states_generation(-1) {}
+
+private:
+    mutable QReadWriteLock lock;
+    typedef QPair<QString, int> key;
+    QHash<key, line> lines, previous;
+    int max_lines;
+    QVector<int> states;
+    int states_generation;
+};
+
+#endif // SPANSTORE_H
@@ -24,26 +24,25 @@
 #include <SWI-cpp.h>
 #include "SwiPrologEngine.h"
 #include "PREDICATE.h"
+#include "Swipl_Streams.h"
 
 #include "ConsoleEdit.h"
+#include "EnginePool.h"
+#include "QueryScheduler.h"
 #include "do_events.h"
 
 #include <QtDebug>
 #include <QApplication>
 #include <signal.h>
 #include <QTimer>
-#include <QFile>
-
-/** singleton handling - process main engine
- */
-SwiPrologEngine *SwiPrologEngine::spe;
 
 /** enforce singleton handling
  */
 SwiPrologEngine::SwiPrologEngine(ConsoleEdit *target, QObject *parent)
     : QThread(parent),
       FlushOutputEvents(target),
-      argc(-1)
+      argc(-1),
+      input_blocked(false)
 {
     Q_ASSERT(spe == 0);
     spe = this;
@@ -72,10 +71,22 @@ void SwiPrologEngine::start(int argc, char **argv) {
 }
 
 /** from console front end: user - or a equivalent actor - has input s
+ *  when not all fits, input_drained will be emitted once reader consumed enough
+ */
+int SwiPrologEngine::take_input(const QString &s, int from) {
+    QMutexLocker lk(&sync);
+    int n = input.append(s, from);
+    if (from + n < s.length())
+        input_blocked = true;
+    ready.wakeAll();
+    return n;
+}
+
+/** wake the reader, i.e. to handle a signal just raised
  */
-void SwiPrologEngine::user_input(QString s) {
+void SwiPrologEngine::wakeup() {
     QMutexLocker lk(&sync);
-    buffer = s.toUtf8();
+    ready.wakeAll();
 }
 
 /** fill the buffer
@@ -87,10 +98,15 @@ ssize_t SwiPrologEngine::_read_(void *handle, char *buf, size_t bufsize) {
 }
 
 /** background read & query loop
+ *  sleeps on <ready> til user_input, query_run or int_request
  */
 ssize_t SwiPrologEngine::_read_(char *buf, size_t bufsize) {
 
-    if (buffer.isEmpty())
+    bool prompt;
+    {   QMutexLocker lk(&sync);
+        prompt = input.isEmpty();
+    }
+    if (prompt)
         emit user_prompt(PL_thread_self(), is_tty(this));
 
     for ( ; ; ) {
@@ -100,14 +116,20 @@ ssize_t SwiPrologEngine::_read_(char *buf, size_t bufsize) {
             if (!spe) // terminated
                 return 0;
 
-            if (!queries.empty())
-                serve_query(queries.takeFirst());
+            if (!queries.empty()) {
+                // don't hold the lock while running
+                query q = queries.takeFirst();
+                lk.unlock();
+                serve_query(q);
+                continue;
+            }
 
-            uint n = buffer.length();
-            if (n > 0) {
-                uint l = bufsize < n ? bufsize : n;
-                memcpy(buf, buffer, l);
-                buffer.remove(0, l);
+            if (int l = input.read(buf, int(bufsize))) {
+                if (input_blocked && input.drained()) {
+                    input_blocked = false;
+                    lk.unlock();
+                    emit input_drained();
+                }
                 return l;
             }
 
@@ -115,43 +137,26 @@ ssize_t SwiPrologEngine::_read_(char *buf, size_t bufsize) {
                 target->status = ConsoleEdit::running;
                 return 0;
             }
+
+            // timeout only to catch signals not raised by int_request
+            ready.wait(&sync, signal_poll_ms);
         }
 
         if (PL_handle_signals() < 0)
             return -1;
-
-        //msleep(100);
     }
 }
 
 /** async query interface served from same thread
+ *  a delayed script can be found here before awake() takes it: load it now
  */
 void SwiPrologEngine::serve_query(query p) {
-
-    query1(call)
-
-    Q_ASSERT(!p.is_script);
-    QString n = p.name, t = p.text;
-    try {
-        int occurrences = 0;
-        if (n.isEmpty()) {
-            call q(C(t.toUtf8()));
-            while (q.next_solution())
-                emit query_result(t, ++occurrences);
-        }
-        else {
-            PlQuery q(A(n), "call", V(C(t.toUtf8())));
-            while (q.next_solution())
-                emit query_result(t, ++occurrences);
-        }
-        emit query_complete(t, occurrences);
-    }
-    catch(PlException ex) {
-        QString detail = t2w(ex);
-        QString message = QString::fromWCharArray(WCP(ex));
-        qDebug() << "PlException" << CT << n << t << detail << message;
-        emit query_exception(t, QString("[%1]\n[%2]").arg(message, detail));
+    if (p.is_script) {
+        if (!named_load(p.name, p.text, true))
+            qDebug() << "serve_query: script failed" << p.name;
     }
+    else if (p.solutions)
+        p.solutions->run();
 }
 
 /** empty the buffer
@@ -159,7 +164,7 @@ void SwiPrologEngine::serve_query(query p) {
 ssize_t SwiPrologEngine::_write_(void *handle, char *buf, size_t bufsize) {
     Q_UNUSED(handle);
     if (spe) {   // not terminated?
-        emit spe->user_output(QString::fromUtf8(buf, bufsize));
+        spe->queue_output(buf, bufsize);
         if (spe->target && spe->target->status == ConsoleEdit::running)
             spe->flush();
     }
@@ -185,6 +190,7 @@ int SwiPrologEngine::halt_engine(int status, void*data)
 { Q_UNUSED(data);
 
   qDebug() << "halt_engine" << status;
+  QueryScheduler::shutdown();
   QCoreApplication::quit();
   msleep(5000);
 
@@ -194,27 +200,7 @@ int SwiPrologEngine::halt_engine(int status, void*data)
 static IOFUNCTIONS pq_functions;
 
 void SwiPrologEngine::run() {
-    pq_functions         = *Sinput->functions;
-    pq_functions.read    = _read_;
-    pq_functions.write	 = _write_;
- // pq_functions.close   = _close_; /* JW: might be needed.  See pl-ntmain.c */
-    pq_functions.control = _control_;
-
-    Sinput->functions  = &pq_functions;
-    Soutput->functions = &pq_functions;
-    Serror->functions  = &pq_functions;
-
-    Sinput->flags  |= SIO_ISATTY;
-    Soutput->flags |= SIO_ISATTY;
-    Serror->flags  |= SIO_ISATTY;
-
-    Sinput->encoding  = ENC_UTF8; /* is this correct? */
-    Soutput->encoding = ENC_UTF8;
-    Serror->encoding  = ENC_UTF8;
-
-    Sinput->flags  &= ~SIO_FILE;
-    Soutput->flags &= ~SIO_FILE;
-    Serror->flags  &= ~SIO_FILE;
+    redirect_std_streams(pq_functions, _read_, _write_, _control_, true);
 
     PL_set_prolog_flag("console_menu", PL_BOOL, TRUE);
     PL_set_prolog_flag("console_menu_version", PL_ATOM, "qt");
@@ -225,6 +211,9 @@ void SwiPrologEngine::run() {
 
     PL_initialise(argc, argv);
 
+    // engines for GUI and foreign threads
+    EnginePool::prefill();
+
     // use as initialized flag
     argc = 0;
 
@@ -242,153 +231,62 @@ void SwiPrologEngine::run() {
 
 /** push an unnamed query, thus unlocking the execution polling loop
  */
-void SwiPrologEngine::query_run(QString text) {
-    QMutexLocker lk(&sync);
-#if !defined(_MSC_VER) || _MSC_VER >= 1800
-    queries.append(query {false, "", text});
-#else
-    queries.append(query(false, "", text));
-#endif
+pqQueryPtr SwiPrologEngine::query_run(QString text, const pqQuery::limits &bounds) {
+    return query_run(QString(), text, bounds);
 }
 
 /** push a named query, thus unlocking the execution polling loop
+ *  outcome is reported by query_result, query_complete, query_exception
  */
-void SwiPrologEngine::query_run(QString module, QString text) {
-    QMutexLocker lk(&sync);
-#if !defined(_MSC_VER) || _MSC_VER >= 1800
-    queries.append(query {false, module, text});
-#else
-    queries.append(query(false, module, text));
-#endif
+pqQueryPtr SwiPrologEngine::query_run(QString module, QString text, const pqQuery::limits &bounds) {
+    pqQueryPtr h(new pqQuery(text, module, 1), &QObject::deleteLater);
+    h->set_bounds(bounds);
+    connect(h.data(), &pqQuery::solved, this, [this, text](int n) { emit query_result(text, n); }, Qt::DirectConnection);
+    connect(h.data(), &pqQuery::completed, this, [this, text](int n) { emit query_complete(text, n); }, Qt::DirectConnection);
+    connect(h.data(), &pqQuery::exception, this, [this, text](QString m) { emit query_exception(text, m); }, Qt::DirectConnection);
+    query_solutions(h);
+    return h;
+}
+
+/** push a solution streaming query, results are delivered by the handle
+ */
+pqQueryPtr SwiPrologEngine::query_solutions(QString goal, int batch_size, int limit, QString module) {
+    pqQueryPtr h(new pqQuery(goal, module, batch_size, limit), &QObject::deleteLater);
+    query_solutions(h);
+    return h;
 }
 
 /** allows to run a delayed script from resource at startup
  */
 void SwiPrologEngine::script_run(QString name, QString text) {
+    {   QMutexLocker lk(&sync);
 #if !defined(_MSC_VER) || _MSC_VER >= 1800
-    queries.append(query {true, name, text});
+        queries.append(query {true, name, text});
 #else
-    queries.append(query(true, name, text));
+        queries.append(query(true, name, text));
 #endif
+    }
     QTimer::singleShot(100, this, SLOT(awake()));
 }
+
+/** load the oldest script still queued, unless the reader served it already
+ */
 void SwiPrologEngine::awake() {
-    Q_ASSERT(queries.count() == 1);
-    query p = queries.takeFirst();
+    query p(false, QString(), QString());
+    {   QMutexLocker lk(&sync);
+        for (int i = 0; i < queries.size() && !p.is_script; ++i)
+            if (queries[i].is_script)
+                p = queries.takeAt(i);
+    }
+    if (!p.is_script)
+        return;
+
     Q_ASSERT(!p.name.isEmpty());
     in_thread I;
     if (!I.named_load(p.name, p.text))
         qDebug() << "awake failed";
 }
 
-/** Create a Prolog thread for the GUI thread, so we can call Prolog
-    goals.  These engines are created to deal with call-backs from the
-    gui and destroyed after the callback has finished. This is used only
-    if the thread associated to the current tab is not running a query.
- */
-SwiPrologEngine::in_thread::in_thread()
-    : frame(0), thid(-1)
-{
-    if (PL_thread_self() == -1) {
-        // no thread yet available
-        while (!spe)
-            msleep(100);
-        while (!spe->isRunning())
-            msleep(100);
-        while (spe->argc)
-            msleep(100);
-
-        PL_thread_attr_t attr;
-        memset(&attr, 0, sizeof(attr));
-        attr.flags = PL_THREAD_NO_DEBUG;
-
-        // CC: aliasing should have a *different* name for different threads...
-        //attr.alias = (char*)"__gui";
-        QByteArray alias;
-        QTextStream(&alias) << "_gt_" << QThread::currentThreadId();
-        attr.alias = alias.data();
-
-        qDebug() << "in_thread:PL_thread_attach_engine" << CT;
-
-        thid = PL_thread_attach_engine(&attr);
-        Q_ASSERT(thid >= 0);			/* JW: Should throw exception */
-    }
-
-    frame = new PlFrame;
-}
-
-SwiPrologEngine::in_thread::~in_thread() {
-    delete frame;
-    if (thid != -1)
-        PL_thread_destroy_engine();
-}
-
-structure1(stream)
-structure1(silent)
-
-predicate2(atom_codes)
-predicate2(open_chars_stream)
-predicate2(load_files)
-predicate1(current_module)
-predicate1(close)
-
-bool SwiPrologEngine::named_load(QString n, QString t, bool silent_yn) {
-    //qDebug() << "SwiPrologEngine::named_load" << n << t.length() << t << silent_yn;
-    try {
-        PlTerm cs, s, opts;
-        if (    atom_codes(A(t), cs) &&
-                open_chars_stream(cs, s)) {
-            PlTail l(opts);
-            l.append(stream(s));
-            if (silent_yn)
-                l.append(silent(A("true")));
-            l.close();
-            //bool rc = load_files(A(n), opts);
-            bool rc = PlCall("user", "load_files", V(A(n), opts));
-            close(s);
-            return rc;
-        }
-    }
-    catch(PlException ex) {
-        qDebug() << t2w(ex);
-    }
-    return false;
-}
-
-/** run script <t>, named <n> in current thread
- */
-bool SwiPrologEngine::in_thread::named_load(QString n, QString t, bool silent_yn) {
-    return SwiPrologEngine::named_load(n, t, silent_yn);
-}
-
-/** if module not yet loaded, load code (i.e. assumes it starts with :-module(module))
- */
-bool SwiPrologEngine::in_thread::inline_module(QString module, QString  code, bool silent) {
-    if (!current_module(A(module))) {
-        qDebug() << "loading module snippet" << module;
-        return named_load(module, code, silent);
-    }
-    qDebug() << "module available" << module;
-    return true;
-}
-
-/** if not yet loaded, parse module code from resource
- */
-bool SwiPrologEngine::in_thread::resource_module(QString module, QString location, bool silent) {
-    if (!current_module(A(module))) {
-        qDebug() << "loading resource_module" << module << "from" << location;
-        QString path = location + "/" + module + ".pl";
-        QFile file(path);
-        if (!file.open(file.ReadOnly | file.Text)) {
-            qDebug() << "path not found" << path;
-            return false;
-        }
-        return named_load(path, file.readAll(), silent);
-    }
-    qDebug() << "module available" << module;
-    return true;
-}
-
 /** handle application quit request in thread that started PL_toplevel
  *  logic moved here from pqMainWindow
  */
@@ -37,6 +37,8 @@
 typedef std::function<void()> pfunc;
 
 #include "FlushOutputEvents.h"
+#include "InputQueue.h"
+#include "pqQuery.h"
 #include "pqConsole_global.h"
 
 /** interface IO running SWI Prolog engine in background
@@ -51,14 +53,25 @@ public:
     /** main console startup point */
     void start(int argc, char **argv);
 
-    /** run query on background thread */
-    void query_run(QString text);
-    void query_run(QString module, QString text);
+    /** run query on background thread, optionally bounded
+     *  the handle allows to cancel it, while queued or running
+     */
+    pqQueryPtr query_run(QString text, const pqQuery::limits &bounds = pqQuery::limits());
+    pqQueryPtr query_run(QString module, QString text, const pqQuery::limits &bounds = pqQuery::limits());
+
+    /** run query on background thread, streaming solutions with bindings
+     *  connect to the handle signals before control returns to event loop
+     */
+    pqQueryPtr query_solutions(QString goal, int batch_size = 100, int limit = 0, QString module = QString());
+    void query_solutions(pqQueryPtr h);
 
     /** run script on background thread */
     void script_run(QString name, QString text);
 
-    /** start/stop a Prolog engine in thread - use for syncronized GUI */
+    /** wake the reader, i.e. to handle a signal just raised */
+    void wakeup();
+
+    /** bind/unbind a pooled Prolog engine to thread - use for syncronized GUI */
     struct PQCONSOLESHARED_EXPORT in_thread {
         in_thread();
         ~in_thread();
@@ -79,6 +92,9 @@ public:
 
         /** create only in not already available */
         int thid;
+
+        /** borrowed from EnginePool, when thread had none */
+        PL_engine_t engine;
     };
 
     /** handle application quit request in thread that started PL_toplevel */
@@ -87,6 +103,9 @@ public:
     /** utility: make public */
     static void msleep(unsigned long n) { QThread::msleep(n); }
 
+    /** upper bound on signal handling latency, for signals not raised by int_request */
+    enum { signal_poll_ms = 250 };
+
     /** query engine about expected interface */
     static bool is_tty(const FlushOutputEvents *target = 0);
 
@@ -95,12 +114,12 @@ public:
 
 signals:
 
-    /** issued to queue a string to user output */
-    void user_output(QString output);
-
     /** issued to peek input - til to CR - from user */
     void user_prompt(int threadId, bool tty);
 
+    /** input queue drained after take_input refused some text: feed more */
+    void input_drained();
+
     /** signal a query result */
     void query_result(QString query, int occurrence);
 
@@ -110,10 +129,10 @@ signals:
     /** signal exception */
     void query_exception(QString query, QString message);
 
-public slots:
+public:
 
-    /** store string in buffer */
-    void user_input(QString input);
+    /** append input from position <from> to bounded queue, return characters taken */
+    int take_input(const QString &input, int from = 0);
 
 protected:
 
@@ -128,14 +147,19 @@ protected:
         bool is_script; // change entry type
         QString name;   // arbitrary symbol
         QString text;   // if is_script is path name, else query text
-        query(bool is_script, const QString & name, const QString & text) :
-           is_script(is_script), name(name), text(text) {}
+        pqQueryPtr solutions;   // the query to run, if not is_script
+        query(bool is_script, const QString & name, const QString & text, pqQueryPtr solutions = pqQueryPtr()) :
+           is_script(is_script), name(name), text(text), solutions(solutions) {}
     };
 
     QMutex sync;
-    QByteArray buffer;      // syncronized !
+    InputQueue input;       // syncronized !
+    bool input_blocked;     // syncronized ! take_input refused text
     QList<query> queries;   // syncronized !
 
+    /** signalled on input, query or interrupt request */
+    QWaitCondition ready;
+
     void serve_query(query q);
 
     static ssize_t _read_(void *handle, char *buf, size_t bufsize);
@@ -155,6 +179,7 @@ private:
     /** main console singleton (thread constructed differently) */
     static SwiPrologEngine* spe;
     friend struct in_thread;
+    friend class QueryScheduler;
 };
 
 #endif // SWIPROLOGENGINE_H
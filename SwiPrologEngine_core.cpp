@@ -0,0 +1,145 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** parts of SwiPrologEngine not depending on the console widgets:
+ *  pooled engines binding, scripts loading, console affinity queries.
+ *  Linked also in headless builds (see pqBatch.cpp)
+ */
+
+#include <SWI-cpp.h>
+#include "SwiPrologEngine.h"
+#include "PREDICATE.h"
+#include "EnginePool.h"
+
+#include <QtDebug>
+#include <QFile>
+
+/** singleton handling - process main engine
+ */
+SwiPrologEngine *SwiPrologEngine::spe;
+
+/** push an already built handle (see QueryScheduler, console affinity)
+ */
+void SwiPrologEngine::query_solutions(pqQueryPtr h) {
+    QMutexLocker lk(&sync);
+    queries.append(query(false, h->module(), h->goal(), h));
+    ready.wakeAll();
+}
+
+/** Create a Prolog thread for the GUI thread, so we can call Prolog
+    goals.  These engines are created to deal with call-backs from the
+    gui and destroyed after the callback has finished. This is used only
+    if the thread associated to the current tab is not running a query.
+ */
+SwiPrologEngine::in_thread::in_thread()
+    : frame(0), thid(-1), engine(0)
+{
+    if (PL_thread_self() == -1) {
+        if (!EnginePool::is_ready()) {
+            // no thread yet available
+            while (!spe)
+                msleep(100);
+            while (!spe->isRunning())
+                msleep(100);
+            while (spe->argc || !EnginePool::is_ready())
+                msleep(100);
+        }
+
+        engine = EnginePool::checkout();
+        Q_ASSERT(engine);			/* JW: Should throw exception */
+        thid = PL_thread_self();
+    }
+
+    frame = new PlFrame;
+}
+
+SwiPrologEngine::in_thread::~in_thread() {
+    delete frame;
+    if (engine)
+        EnginePool::checkin(engine);
+}
+
+structure1(stream)
+structure1(silent)
+
+predicate2(atom_codes)
+predicate2(open_chars_stream)
+predicate2(load_files)
+predicate1(current_module)
+predicate1(close)
+
+bool SwiPrologEngine::named_load(QString n, QString t, bool silent_yn) {
+    //qDebug() << "SwiPrologEngine::named_load" << n << t.length() << t << silent_yn;
+    try {
+        PlTerm cs, s, opts;
+        if (    atom_codes(A(t), cs) &&
+                open_chars_stream(cs, s)) {
+            PlTail l(opts);
+            l.append(stream(s));
+            if (silent_yn)
+                l.append(silent(A("true")));
+            l.close();
+            //bool rc = load_files(A(n), opts);
+            bool rc = PlCall("user", "load_files", V(A(n), opts));
+            close(s);
+            return rc;
+        }
+    }
+    catch(PlException ex) {
+        qDebug() << t2w(ex);
+    }
+    return false;
+}
+
+/** run script <t>, named <n> in current thread
+ */
+bool SwiPrologEngine::in_thread::named_load(QString n, QString t, bool silent_yn) {
+    return SwiPrologEngine::named_load(n, t, silent_yn);
+}
+
+/** if module not yet loaded, load code (i.e. assumes it starts with :-module(module))
+ */
+bool SwiPrologEngine::in_thread::inline_module(QString module, QString  code, bool silent) {
+    if (!current_module(A(module))) {
+        qDebug() << "loading module snippet" << module;
+        return named_load(module, code, silent);
+    }
+    qDebug() << "module available" << module;
+    return true;
+}
+
+/** if not yet loaded, parse module code from resource
+ */
+bool SwiPrologEngine::in_thread::resource_module(QString module, QString location, bool silent) {
+    if (!current_module(A(module))) {
+        qDebug() << "loading resource_module" << module << "from" << location;
+        QString path = location + "/" + module + ".pl";
+        QFile file(path);
+        if (!file.open(file.ReadOnly | file.Text)) {
+            qDebug() << "path not found" << path;
+            return false;
+        }
+        return named_load(path, file.readAll(), silent);
+    }
+    qDebug() << "module available" << module;
+    return true;
+}
@@ -27,7 +27,8 @@
 #include <QTime>
 
 Swipl_IO::Swipl_IO(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    input_blocked(false)
 {
 }
 
@@ -41,7 +42,7 @@ ssize_t Swipl_IO::_read_f(void *handle, char *buf, size_t bufsize) {
 ssize_t Swipl_IO::_write_f(void *handle, char* buf, size_t bufsize) {
     auto e = pq_cast<Swipl_IO>(handle);
     if (e->target) {
-        emit e->user_output(QString::fromUtf8(buf, bufsize));
+        e->queue_output(buf, bufsize);
         e->flush();
     }
     return bufsize;
@@ -77,7 +78,8 @@ int64_t Swipl_IO::_seek64_f(void *handle, int64_t pos, int whence) {
     return 0;
 }
 
-/** polling loop til buffer ready
+/** wait til buffer ready
+ *  sleeps on <ready> til attached, user_input, query_run or int_request
  */
 ssize_t Swipl_IO::_read_(char *buf, size_t bufsize) {
 
@@ -96,70 +98,88 @@ ssize_t Swipl_IO::_read_(char *buf, size_t bufsize) {
                 }
                 break;
             }
+            ready.wait(&sync, SwiPrologEngine::signal_poll_ms);
         }
 
-	if ( PL_handle_signals() < 0 )
-	    return -1;
-
-        SwiPrologEngine::msleep(10);
+        if ( PL_handle_signals() < 0 )
+            return -1;
     }
 
-    if ( buffer.isEmpty() ) {
+    bool prompt;
+    {   QMutexLocker lk(&sync);
+        prompt = input.isEmpty();
+    }
+    if ( prompt ) {
         PL_write_prompt(TRUE);
-	emit user_prompt(thid, SwiPrologEngine::is_tty(this));
+        emit user_prompt(thid, SwiPrologEngine::is_tty(this));
     }
 
     for ( ; ; ) {
 
         {   QMutexLocker lk(&sync);
 
-            if (!query.isEmpty()) {
-                try {
-                    int rc = PlCall(query.toStdWString().data());
-                    qDebug() << "PlCall" << query << rc;
-                }
-                catch(PlException e) {
-                    qDebug() << t2w(e);
-                }
-                query.clear();
+            if (!queries.isEmpty()) {
+                // don't hold the lock while running
+                pqQueryPtr q = queries.takeFirst();
+                lk.unlock();
+                q->run();
+                qDebug() << "query_run" << q->goal() << q->count();
+                continue;
             }
 
-            uint n = buffer.length();
-            Q_ASSERT(bufsize >= n);
-            if (n > 0) {
-                uint l = bufsize < n ? bufsize : n;
-                memcpy(buf, buffer, l);
-                buffer.remove(0, l);
+            if (int l = input.read(buf, int(bufsize))) {
+                if (input_blocked && input.drained()) {
+                    input_blocked = false;
+                    lk.unlock();
+                    emit input_drained();
+                }
                 return l;
             }
 
             if (target->status == ConsoleEdit::eof) {
-	        target->status = ConsoleEdit::running;
+                target->status = ConsoleEdit::running;
                 return 0;
-	    }
-        }
+            }
 
-	if ( PL_handle_signals() < 0 )
-	    return -1;
+            // timeout only to catch signals not raised by int_request
+            ready.wait(&sync, SwiPrologEngine::signal_poll_ms);
+        }
 
-        SwiPrologEngine::msleep(10);
+        if ( PL_handle_signals() < 0 )
+            return -1;
     }
 }
 
 /** syncronized storage of user input from console front end
+ *  when not all fits, input_drained will be emitted once reader consumed enough
  */
-void Swipl_IO::user_input(QString s) {
+int Swipl_IO::take_input(const QString &cmd, int from) {
     QMutexLocker lk(&sync);
-    buffer = s.toUtf8();
+    int n = input.append(cmd, from);
+    if (from + n < cmd.length())
+        input_blocked = true;
+    ready.wakeAll();
+    return n;
 }
 
-void Swipl_IO::take_input(QString cmd) {
+/** wake the reader, i.e. to handle a signal just raised
+ */
+void Swipl_IO::wakeup() {
     QMutexLocker lk(&sync);
-    buffer = cmd.toUtf8();
+    ready.wakeAll();
 }
 
 void Swipl_IO::eng_at_exit(void *p) {
     auto e = pq_cast<Swipl_IO>(p);
+
+    // queries left behind will never run: report them
+    QList<pqQueryPtr> pending;
+    {   QMutexLocker lk(&e->sync);
+        pending.swap(e->queries);
+    }
+    foreach (pqQueryPtr q, pending)
+        q->cancel();
+
     emit e->sig_eng_at_exit();
 }
 
@@ -167,10 +187,18 @@ void Swipl_IO::attached(ConsoleEdit *c) {
     QMutexLocker lk(&sync);
     Q_ASSERT(target == 0);
     target = c;
+    ready.wakeAll();
 }
 
-void Swipl_IO::query_run(QString newquery) {
+pqQueryPtr Swipl_IO::query_run(QString text, const pqQuery::limits &bounds) {
+    pqQueryPtr h(new pqQuery(text, QString(), 1), &QObject::deleteLater);
+    h->set_bounds(bounds);
+    connect(h.data(), &pqQuery::solved, this, [this, text](int n) { emit query_result(text, n); }, Qt::DirectConnection);
+    connect(h.data(), &pqQuery::completed, this, [this, text](int n) { emit query_complete(text, n); }, Qt::DirectConnection);
+    connect(h.data(), &pqQuery::exception, this, [this, text](QString m) { emit query_exception(text, m); }, Qt::DirectConnection);
+
     QMutexLocker lk(&sync);
-    Q_ASSERT(query.isEmpty());
-    query = newquery;
+    queries.append(h);
+    ready.wakeAll();
+    return h;
 }
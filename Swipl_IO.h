@@ -44,46 +44,64 @@ public:
     /** standard interface */
     explicit Swipl_IO(QObject *parent = 0);
 
-    /** surrogate signal/slot not working in foreign thread */
-    void take_input(QString cmd);
+    /** append input from position <from> to bounded queue, return characters taken
+     *  surrogate signal/slot not working in foreign thread
+     */
+    int take_input(const QString &cmd, int from = 0);
 
     /** foreign thread connection completed */
     void attached(ConsoleEdit *c);
 
-    void query_run(QString query);
+    /** queue query to run in this thread between reads, optionally bounded
+     *  outcome is reported by query_result, query_complete, query_exception
+     */
+    pqQueryPtr query_run(QString text, const pqQuery::limits &bounds = pqQuery::limits());
+
+    /** wake the reader, i.e. to handle a signal just raised */
+    void wakeup();
 
 private:
 
-    /** syncronize inter thread access to buffer and query */
+    /** syncronize inter thread access to buffer and queries */
     QMutex sync;
 
-    /** output text buffer, made UTF8 */
-    QByteArray buffer;
+    /** signalled on attach, input, query or interrupt request */
+    QWaitCondition ready;
+
+    /** user input, handed out to reader as UTF8 */
+    InputQueue input;
+
+    /** take_input refused some text, input_drained is due */
+    bool input_blocked;
 
     /** factorize access to members */
     ssize_t _read_(char *buf, size_t bufsize);
 
-    /** allows a call without issuing the read */
-    QString query;
+    /** allows calls without issuing the read, served in order */
+    QList<pqQueryPtr> queries;
 
     /** termination control */
     static void eng_at_exit(void *);
 
 signals:
 
-    /** issued to queue a string to user output */
-    void user_output(QString output);
-
     /** issued to peek input - til to CR - from user */
     void user_prompt(int threadId, bool tty);
 
-    /**  attempt to run generic code inter threads */
-    void sig_eng_at_exit();
+    /** input queue drained after take_input refused some text: feed more */
+    void input_drained();
+
+    /** signal a query result */
+    void query_result(QString query, int occurrence);
+
+    /** signal query completed */
+    void query_complete(QString query, int tot_occurrences);
 
-public slots:
+    /** signal exception */
+    void query_exception(QString query, QString message);
 
-    /** store string in buffer */
-    void user_input(QString input);
+    /**  attempt to run generic code inter threads */
+    void sig_eng_at_exit();
 };
 
 #endif // SWIPL_IO_H
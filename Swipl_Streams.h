@@ -0,0 +1,37 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SWIPL_STREAMS_H
+#define SWIPL_STREAMS_H
+
+#include "pqConsole_global.h"
+#include <SWI-Stream.h>
+
+/** route Sinput, Soutput and Serror through <functions>
+ *  a copy of the default functions, with read, write and (if not null) control replaced.
+ *  Streams are UTF-8 and not files; <tty> marks them interactive.
+ *  Call before PL_initialise, <functions> must outlive the engine.
+ */
+PQCONSOLESHARED_EXPORT void redirect_std_streams(IOFUNCTIONS &functions,
+    Sread_function read, Swrite_function write, Scontrol_function control, bool tty);
+
+#endif // SWIPL_STREAMS_H
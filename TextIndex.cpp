@@ -0,0 +1,112 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "TextIndex.h"
+#include <algorithm>
+
+TextIndex::TextIndex(QString text, int base)
+    : text(text), base_(base) {
+}
+
+void TextIndex::build() {
+    QHash<QString, int> ids;
+    for (int i = 0, n = text.length(); i < n; ) {
+        if (!is_word(text[i])) {
+            ++i;
+            continue;
+        }
+        int j = i + 1;
+        while (j < n && is_word(text[j]))
+            ++j;
+
+        QString w = text.mid(i, j - i);
+        auto p = ids.constFind(w);
+        int id;
+        if (p == ids.constEnd()) {
+            ids.insert(w, id = words.size());
+            words.append(w);
+            offsets.append(QVector<int>());
+            for (int k = 0; k + 3 <= w.length(); ++k) {
+                QVector<int> &g = grams[gram(w.constData() + k)];
+                if (g.isEmpty() || g.last() != id)
+                    g.append(id);
+            }
+        }
+        else
+            id = *p;
+        offsets[id].append(i);
+        i = j;
+    }
+    built.storeRelease(1);
+}
+
+/** a selection made of word characters can only occur inside words:
+ *  scan candidate distinct words instead of text. Otherwise, scan text
+ */
+QVector<int> TextIndex::find(QString s) {
+    QVector<int> found;
+    if (s.isEmpty())
+        return found;
+
+    bool word = true;
+    foreach (QChar c, s)
+        if (!is_word(c)) {
+            word = false;
+            break;
+        }
+
+    if (!word) {
+        for (int p = text.indexOf(s); p >= 0; p = text.indexOf(s, p + s.length()))
+            found.append(base_ + p);
+        return found;
+    }
+
+    QMutexLocker lk(&sync);
+    if (!ready())
+        build();
+
+    auto scan = [&](int id) {
+        const QString &w = words[id];
+        for (int o = w.indexOf(s); o >= 0; o = w.indexOf(s, o + s.length()))
+            foreach (int p, offsets[id])
+                found.append(base_ + p + o);
+    };
+
+    if (s.length() < 3)
+        for (int id = 0; id < words.size(); ++id)
+            scan(id);
+    else {
+        const QVector<int> *shortest = 0;
+        for (int i = 0; i + 3 <= s.length(); ++i) {
+            auto g = grams.constFind(gram(s.constData() + i));
+            if (g == grams.constEnd())
+                return found;
+            if (!shortest || g->size() < shortest->size())
+                shortest = &*g;
+        }
+        foreach (int id, *shortest)
+            scan(id);
+    }
+
+    std::sort(found.begin(), found.end());
+    return found;
+}
@@ -0,0 +1,78 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef TEXTINDEX_H
+#define TEXTINDEX_H
+
+#include "pqConsole_global.h"
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <QAtomicInt>
+
+/** words of a text snapshot, to locate occurrences of a selection
+ *  the index is built on first find(), possibly off the GUI thread.
+ *  Distinct words are indexed by trigrams, so a selection of 3 or more
+ *  word characters is only compared with words sharing its rarest trigram
+ */
+class PQCONSOLESHARED_EXPORT TextIndex {
+public:
+
+    /** <text> started at document position <base> when taken */
+    TextIndex(QString text, int base);
+
+    /** snapshot spans range [from, to), in positions at snapshot time */
+    bool covers(int from, int to) const {
+        return from >= base_ && to <= base_ + text.length();
+    }
+
+    /** document position of text, at snapshot time */
+    int base() const { return base_; }
+
+    /** document positions (at snapshot time) where s occurs, sorted */
+    QVector<int> find(QString s);
+
+    /** index built, so find() is cheap */
+    bool ready() const { return built.loadAcquire(); }
+
+    int length() const { return text.length(); }
+
+private:
+    QString text;
+    int base_;
+
+    QMutex sync;
+    QAtomicInt built;
+
+    /** distinct words, their offsets in text, and trigram -> word ids, in increasing order */
+    QVector<QString> words;
+    QVector<QVector<int>> offsets;
+    QHash<quint64, QVector<int>> grams;
+    void build();
+
+    static bool is_word(QChar c) { return c.isLetterOrNumber() || c == '_'; }
+    static quint64 gram(const QChar *s) {
+        return quint64(s[0].unicode()) << 32 | quint64(s[1].unicode()) << 16 | s[2].unicode();
+    }
+};
+
+#endif // TEXTINDEX_H
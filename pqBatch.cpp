@@ -0,0 +1,212 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** headless batch runner, built with qmake CONFIG+=pq_batch
+ *
+ *  pqBatch [-j N] [-o out.jsonl] [--timeout ms] [--inferences n] [--max-solutions n] queries [-- swipl args]
+ *
+ *  queries file has a goal per line (final full stop optional, % comments and blank lines skipped).
+ *  Each goal is run on a QueryScheduler worker, and a JSON record is written per goal,
+ *  in completion order, with solutions count, bindings, cpu, inferences, wall time.
+ *  Prolog output goes to stderr, using the same IOFUNCTIONS redirection of SwiPrologEngine::run().
+ *  Only QtCore is linked: see the pq_batch config in pqConsole.pro.
+ */
+
+#include <SWI-cpp.h>
+#include "Swipl_Streams.h"
+#include "EnginePool.h"
+#include "QueryScheduler.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QVector>
+#include <QTextStream>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <stdio.h>
+
+static IOFUNCTIONS batch_functions;
+
+/** no interactive input: end of file */
+static ssize_t batch_read(void *handle, char *buf, size_t bufsize) {
+    Q_UNUSED(handle);
+    Q_UNUSED(buf);
+    Q_UNUSED(bufsize);
+    return 0;
+}
+
+/** keep stdout for records */
+static ssize_t batch_write(void *handle, char *buf, size_t bufsize) {
+    Q_UNUSED(handle);
+    size_t n = fwrite(buf, 1, bufsize, stderr);
+    fflush(stderr);
+    return ssize_t(n);
+}
+
+/** goals from file, one per line, false if the file can't be read */
+static bool read_queries(QString path, QStringList &queries) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly|QIODevice::Text))
+        return false;
+
+    QTextStream s(&f);
+    s.setCodec("UTF-8");
+    while (!s.atEnd()) {
+        QString l = s.readLine().trimmed();
+        if (l.isEmpty() || l.startsWith('%'))
+            continue;
+        if (l.endsWith('.'))
+            l.chop(1);
+        queries << l;
+    }
+    return s.status() == QTextStream::Ok;
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("pqBatch");
+
+    QCommandLineParser cl;
+    cl.setApplicationDescription("run SWI-Prolog goals from file, write a JSON record per goal");
+    cl.addHelpOption();
+    QCommandLineOption
+        jobs("j", "worker engines", "N", "1"),
+        output("o", "records file (default stdout)", "path"),
+        timeout("timeout", "wall clock limit per goal", "ms", "0"),
+        inferences("inferences", "inference limit per goal", "n", "0"),
+        max_solutions("max-solutions", "stop each goal after n solutions (0 = all)", "n", "0");
+    cl.addOption(jobs);
+    cl.addOption(output);
+    cl.addOption(timeout);
+    cl.addOption(inferences);
+    cl.addOption(max_solutions);
+    cl.addPositionalArgument("queries", "goals file");
+    cl.addPositionalArgument("swipl", "after --, arguments for PL_initialise", "[-- args...]");
+    cl.process(app);
+
+    QStringList args = cl.positionalArguments();
+    if (args.isEmpty())
+        cl.showHelp(1);
+
+    QString queries_path = args.takeFirst();
+    QStringList queries;
+    if (!read_queries(queries_path, queries)) {
+        fprintf(stderr, "cannot read %s\n", qPrintable(queries_path));
+        return 1;
+    }
+
+    QFile out;
+    if (cl.isSet(output)) {
+        out.setFileName(cl.value(output));
+        if (!out.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+            fprintf(stderr, "cannot open %s\n", qPrintable(cl.value(output)));
+            return 1;
+        }
+    }
+    else
+        out.open(stdout, QIODevice::WriteOnly);
+
+    // Prolog arguments, argv[0] first
+    QList<QByteArray> pl_args;
+    pl_args << argv[0];
+    foreach (QString a, args)
+        pl_args << a.toLocal8Bit();
+    QVector<char*> pl_argv;
+    for (int i = 0; i < pl_args.size(); ++i)
+        pl_argv << pl_args[i].data();
+    pl_argv << 0;
+
+    redirect_std_streams(batch_functions, batch_read, batch_write, 0, false);
+    if (!PL_initialise(pl_argv.size() - 1, pl_argv.data())) {
+        fprintf(stderr, "PL_initialise failed\n");
+        return 1;
+    }
+    EnginePool::prefill();
+
+    if (queries.isEmpty()) {
+        PL_halt(0);
+        return 0;
+    }
+
+    QueryScheduler::set_workers(qMax(1, cl.value(jobs).toInt()));
+    pqQuery::limits bounds(cl.value(timeout).toInt(), cl.value(inferences).toLong());
+    int limit = cl.value(max_solutions).toInt();
+
+    QMutex out_sync;
+    QAtomicInt remaining(queries.size()), failures(0);
+    QList<pqQueryPtr> handles;
+
+    for (int i = 0; i < queries.size(); ++i) {
+        pqQueryPtr h(new pqQuery(queries[i], QString(), 1000, limit), &QObject::deleteLater);
+        h->set_bounds(bounds);
+
+        // records are built in worker threads
+        auto bindings = QSharedPointer<QJsonArray>::create();
+        pqQuery *q = h.data();
+
+        auto record = [=, &out, &out_sync, &remaining](QString error) {
+            QJsonObject r;
+            r["index"] = i;
+            r["query"] = q->goal();
+            r["solutions"] = q->count();
+            r["bindings"] = *bindings;
+            r["status"] = error.isNull() ? (q->count() ? "true" : "false") : "exception";
+            if (!error.isNull())
+                r["error"] = error;
+            r["cpu"] = q->cpu_time();
+            r["inferences"] = double(q->inferences());
+            r["wall_ms"] = double(q->wall_ms());
+            {   QMutexLocker lk(&out_sync);
+                out.write(QJsonDocument(r).toJson(QJsonDocument::Compact));
+                out.write("\n");
+                out.flush();
+            }
+            if (!remaining.deref())
+                QMetaObject::invokeMethod(qApp, "quit", Qt::QueuedConnection);
+        };
+
+        QObject::connect(q, &pqQuery::solutions, [=](QVariantList batch) {
+            foreach (QVariant s, batch)
+                bindings->append(QJsonValue::fromVariant(s));
+        });
+        QObject::connect(q, &pqQuery::completed, [=](int) {
+            record(QString());
+        });
+        QObject::connect(q, &pqQuery::exception, [=, &failures](QString error) {
+            failures.ref();
+            record(error);
+        });
+
+        handles << h;
+        QueryScheduler::submit(h);
+    }
+
+    app.exec();
+
+    QueryScheduler::shutdown();
+    int rc = failures.load() ? 2 : 0;
+    PL_halt(rc);
+    return rc;
+}
@@ -0,0 +1,172 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** lexer benchmark, built with qmake CONFIG+=pq_bench
+ *
+ *  pqBench [file.pl] [rounds]
+ *
+ *  Lexes a file (default: 50000 generated lines) line by line, carrying state
+ *  as the highlighter does, with the QRegExp scanner pqMiniSyntax used before
+ *  and with PrologLexer. Reports best of <rounds> for each, and the speedup.
+ *  Exit status is 1 when PrologLexer is less than 10 times faster.
+ */
+
+#include "PrologLexer.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QRegExp>
+#include <QFile>
+#include <QTextStream>
+
+/** a source mixing the tokens found in typical Prolog code */
+static QStringList generate(int lines) {
+    QStringList s;
+    for (int n = 0; s.size() < lines; ++n) {
+        QString i = QString::number(n);
+        s << "% clause " + i + ", with some commentary text"
+          << "pred_" + i + "(X, Y, [H|T], 'quoted atom " + i + "') :-"
+          << "    member(H-V, [a-1, b-2, c-0x1F, d-0'a]),"
+          << "    /* a block comment"
+          << "       spanning lines */"
+          << "    Y is X * 3.14e-2 + " + i + " mod 7,"
+          << "    format(\"~w: ~q~n\", [Y, `back`]),"
+          << "    (   T == [] -> true ; pred_" + i + "(X, _, T, _) )."
+          << "";
+    }
+    return s.mid(0, lines);
+}
+
+/** the QRegExp scanner of pqMiniSyntax before PrologLexer, setFormat replaced by counting */
+struct old_lexer {
+    QRegExp tokens;
+
+    old_lexer() {
+        QString number("\\d+(?:\\.\\d+)?");
+        QString symbol("[a-z][A-Za-z0-9_]*");
+        QString var("[A-Z_][A-Za-z0-9_]*");
+        QString quoted("\"[^\"]*\"");
+        QString atomq("'[^\'']*'");
+        QString atombackq("`[^`]*`");
+        QString charcode("0'.|0'\\t|0'\\n|0'\\r|0'\\u[0-9][0-9][0-9][0-9]");
+        QString oper("[\\+\\-\\*\\/\\=\\^<>~:\\.,;\\?@#$\\\\&{}`]+");
+
+        tokens = QRegExp(QString("(%1)|(%2)|(%3)|(%4)|(%5)|(%6)|(%7)|(%8)|%").arg(number, symbol, var, quoted, atomq, atombackq, charcode, oper));
+    }
+
+    int lex(const QString &text, int &state, int &spans) {
+        for (int i = 0, j, l; ; i = j + l)
+            if (state) {
+                if ((j = text.indexOf("*/", i)) == -1) {
+                    ++spans;
+                    break;
+                }
+                l = 2;
+                ++spans;
+                state = 0;
+            } else {
+                if ((j = tokens.indexIn(text, i)) == -1)
+                    break;
+                QStringList ml = tokens.capturedTexts();
+                l = 0;
+                for (int k = 1; k <= 8 && !l; ++k)
+                    l = ml[k].length();
+                ++spans;
+                if (!l) // single line comment
+                    break;
+                if (l >= 2 && ml[8].left(2) == "/*") {
+                    l = 2;
+                    state = 1;
+                }
+            }
+        return state;
+    }
+};
+
+/** best elapsed of <rounds> passes over <lines> */
+template <class pass>
+static qint64 best(int rounds, pass p) {
+    qint64 b = -1;
+    for (int r = 0; r < rounds; ++r) {
+        QElapsedTimer t;
+        t.start();
+        p();
+        qint64 e = t.nsecsElapsed();
+        if (b < 0 || e < b)
+            b = e;
+    }
+    return b;
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    QTextStream out(stdout);
+
+    QStringList lines;
+    if (args.size() > 1) {
+        QFile f(args[1]);
+        if (!f.open(f.ReadOnly | f.Text)) {
+            QTextStream(stderr) << "pqBench: can't read " << args[1] << endl;
+            return 2;
+        }
+        lines = QString::fromUtf8(f.readAll()).split('\n');
+    }
+    else
+        lines = generate(50000);
+    int rounds = args.size() > 2 ? qMax(1, args[2].toInt()) : 5;
+
+    qint64 chars = 0;
+    foreach (QString l, lines)
+        chars += l.length() + 1;
+
+    int old_spans = 0, new_spans = 0;
+    old_lexer o;
+    qint64 t_old = best(rounds, [&]() {
+        int state = 0;
+        old_spans = 0;
+        foreach (const QString &l, lines)
+            o.lex(l, state, old_spans);
+    });
+    qint64 t_new = best(rounds, [&]() {
+        int state = 0;
+        new_spans = 0;
+        foreach (const QString &l, lines)
+            state = PrologLexer::lex(l, state, [&](int, int, PrologLexer::token) { ++new_spans; });
+    });
+
+    auto report = [&](QString name, qint64 ns, int spans) {
+        out << QString("%1 %2 lines %3 ms %4 Klines/s %5 MB/s %6 spans")
+               .arg(name, -12).arg(lines.size())
+               .arg(ns / 1e6, 0, 'f', 2)
+               .arg(lines.size() / (ns / 1e6), 0, 'f', 1)
+               .arg(chars * 2 / (ns / 1e3), 0, 'f', 1)
+               .arg(spans) << endl;
+    };
+    report("QRegExp", t_old, old_spans);
+    report("PrologLexer", t_new, new_spans);
+
+    double speedup = double(t_old) / qMax(t_new, qint64(1));
+    out << QString("speedup %1x").arg(speedup, 0, 'f', 1) << endl;
+    return speedup >= 10 ? 0 : 1;
+}
@@ -33,6 +33,8 @@
 #include "Preferences.h"
 #include "pqMainWindow.h"
 #include "pqMiniSyntax.h"
+#include "EnginePool.h"
+#include "HistoryStore.h"
 
 #include <QTime>
 #include <QStack>
@@ -47,6 +49,7 @@
 #include <QMainWindow>
 #include <QApplication>
 #include <QFontMetrics>
+#include <QFileInfo>
 
 /** Run a default GUI to demo the ability to embed Prolog with minimal effort.
  *  It will evolve - eventually - from a demo
@@ -71,7 +74,7 @@ int pqConsole::showMiniSyntax(int argc, char *argv[]) {
         if (f.open(f.ReadOnly)) {
             QTextEdit *ed = new QTextEdit();
             ed->setText(QTextStream(&f).readAll());
-            new pqMiniSyntax(ed);
+            (new pqMiniSyntax(ed))->setSemantic(QFileInfo(f).absoluteFilePath());
             ed->show();
         }
     }
@@ -126,24 +129,76 @@ void pqConsole::addConsole(ConsoleEdit* c) {
     QMutexLocker l(&consoles_sync);
     Q_ASSERT(!consoles.contains(c));
     consoles.append(c);
+    // by_thread() answer for foreign threads may change
+    thread_consoles_generation.ref();
 }
 
 void pqConsole::removeConsole(ConsoleEdit* c) {
-    QMutexLocker l(&consoles_sync);
-    Q_ASSERT(consoles.contains(c));
-    consoles.removeOne(c);
+    {   QMutexLocker l(&consoles_sync);
+        Q_ASSERT(consoles.contains(c));
+        consoles.removeOne(c);
+    }
+    QWriteLocker l(&thread_consoles_sync);
+    for (auto i = thread_consoles.begin(); i != thread_consoles.end(); )
+        if (*i == c)
+            i = thread_consoles.erase(i);
+        else
+            ++i;
+    thread_consoles_generation.ref();
 }
 
-/** search widgets hierarchy looking for the first (the only)
- *  that owns the calling thread ID
+QHash<int, ConsoleEdit*> pqConsole::thread_consoles;
+QReadWriteLock pqConsole::thread_consoles_sync;
+QAtomicInt pqConsole::thread_consoles_generation;
+
+ConsoleEdit *pqConsole::bind_thread(int thid, ConsoleEdit *c) {
+    QWriteLocker l(&thread_consoles_sync);
+    ConsoleEdit *previous = thread_consoles.value(thid);
+    thread_consoles[thid] = c;
+    thread_consoles_generation.ref();
+    return previous;
+}
+
+/** give back thid to previous owner, unless it has been removed meanwhile
+ */
+void pqConsole::unbind_thread(int thid, ConsoleEdit *c, ConsoleEdit *previous) {
+    QMutexLocker lc(&consoles_sync);
+    QWriteLocker l(&thread_consoles_sync);
+    if (thread_consoles.value(thid) == c) {
+        if (previous && consoles.contains(previous))
+            thread_consoles[thid] = previous;
+        else
+            thread_consoles.remove(thid);
+        thread_consoles_generation.ref();
+    }
+}
+
+/** the console that owns the calling thread ID
+ *  last answer is cached per thread, valid while the map is unchanged;
+ *  a thread unknown to Prolog (-1) gets the first console
  */
 ConsoleEdit *pqConsole::by_thread() {
-    QMutexLocker l(&consoles_sync);
+    static thread_local struct { int generation, thid; ConsoleEdit *console; } cache = { -1, -1, 0 };
+
     int thid = PL_thread_self();
-    foreach (ConsoleEdit *ce, consoles)
-        if (ce->match_thread(thid))
-            return ce;
-    return 0;
+    int generation = thread_consoles_generation.loadAcquire();
+    if (cache.generation == generation && cache.thid == thid)
+        return cache.console;
+
+    ConsoleEdit *c;
+    if (thid == -1) {
+        QMutexLocker l(&consoles_sync);
+        c = consoles.isEmpty() ? 0 : consoles[0];
+    }
+    else {
+        QReadLocker l(&thread_consoles_sync);
+        c = thread_consoles.value(thid);
+    }
+
+    cache.generation = generation;
+    cache.thid = thid;
+    cache.console = c;
+    return c;
 }
 
 /** search widgets hierarchy looking for any ConsoleEdit
@@ -165,6 +220,31 @@ void pqConsole::gui_run(pfunc f) {
     s.stop();
 }
 
+/** as above, paying one round trip for all
+ */
+void pqConsole::gui_run(QList<pfunc> fs) {
+    ConsoleEdit::exec_sync s;
+    peek_first()->exec_func([&]() {
+        foreach (pfunc f, fs)
+            f();
+        s.go();
+    });
+    s.stop();
+}
+
+/** gui_run_latency(-Histogram, +Reset)
+ *  round trips to GUI thread (gui_run and exec_sync), as list of MaxMicroseconds-Count,
+ *  for non empty buckets. Reset (true/false) clears counters after reading
+ */
+PREDICATE(gui_run_latency, 2) {
+    QVector<int> h = ConsoleEdit::exec_sync::latency_histogram(t2w(PL_A2) == "true");
+    PlTail l(PL_A1);
+    for (int b = 0; b < h.size(); ++b)
+        if (h[b])
+            l.append(PlCompound("-", PlTermv(long(2) << b, long(h[b]))));
+    return l.close();
+}
+
 /** append new command to history list for current console
  */
 PREDICATE(rl_add_history, 1) {
@@ -185,13 +265,11 @@ PREDICATE(rl_read_init_file, 1) {
     return TRUE;
 }
 
-/** get history lines for this console
+/** get history lines, from persistent store shared by consoles
  */
-QStringList pqConsole::last_history_lines;
-
 NAMED_PREDICATE("$rl_history", rl_history, 1) {
     PlTail lines(PL_A1);
-    foreach(QString x, pqConsole::last_history_lines)
+    foreach(QString x, HistoryStore::shared().lines())
         lines.append(W(x));
     lines.close();
     return TRUE;
@@ -234,6 +312,22 @@ PREDICATE0(interrupt) {
  *  pq - updateRefreshRate(N) default 100
  *     - allow to alter default refresh rate (simply count outputs before setting cursor at end)
  *
+ *  pq - outputFrameRate(N) default 60
+ *     - how many times per second output is appended and autoscrolled
+ *
+ *  pq - outputHighWater(N) default 262144
+ *     - pending output bytes before the engine waits for the GUI
+ *
+ *  pq - outputFlushSync(Bool) default false
+ *     - when true, each flush waits for the GUI to repaint (old behaviour)
+ *
+ *  pq - scrollbackLimit(N) default from preferences (0, unlimited)
+ *     - blocks kept in document, older text spills to a disk log (see scrollback_search/2)
+ *     - lines paged back in stay until scrolled out of view
+ *
+ *  pq - completionDelay(Ms) default 60
+ *     - typing pause before the visible completion list is refreshed, in background
+ *
  *  Qt - maximumBlockCount(N) default 0
  *     - remove (from top) text lines when exceeding the limit
  *
@@ -259,6 +353,65 @@ PREDICATE(console_settings, 1) {
     return FALSE;
 }
 
+/** scrollback_search(+Text, -Lines)
+ *  line numbers of output evicted from console containing Text, newest first
+ */
+PREDICATE(scrollback_search, 2) {
+    ConsoleEdit* c = pqConsole::by_thread();
+    if (c) {
+        QString Text = t2w(PL_A1);
+        QList<int> found;
+        pqConsole::gui_run([&]() { found = c->scrollback_find(Text); });
+        PlTail l(PL_A2);
+        foreach (int n, found)
+            l.append(long(n));
+        return l.close();
+    }
+    return FALSE;
+}
+
+/** scrollback_page_in(+Count, -Restored)
+ *  bring back on top of console the newest Count evicted lines
+ */
+PREDICATE(scrollback_page_in, 2) {
+    ConsoleEdit* c = pqConsole::by_thread();
+    if (c) {
+        int Count = int(long(PL_A1)), Restored = 0;
+        pqConsole::gui_run([&]() { Restored = c->scrollback_page_in(Count); });
+        return PL_A2 = long(Restored);
+    }
+    return FALSE;
+}
+
+/** engine_pool_stats(-Stats)
+ *  counters of engines pool used by GUI and foreign threads, as Key=Value list
+ */
+PREDICATE(engine_pool_stats, 1) {
+    EnginePool::stats_t s = EnginePool::stats();
+    PlTail l(PL_A1);
+    #define KV(k) l.append(PlCompound("=", PlTermv(A(#k), long(s.k))))
+    KV(capacity);
+    KV(idle);
+    KV(in_use);
+    KV(max_in_use);
+    KV(created);
+    KV(destroyed);
+    KV(checkouts);
+    KV(misses);
+    #undef KV
+    return l.close();
+}
+
+/** engine_pool_size(?Size)
+ *  get or set engines kept idle in pool
+ */
+PREDICATE(engine_pool_size, 1) {
+    if (PL_A1.type() == PL_VARIABLE)
+        return PL_A1 = long(EnginePool::capacity());
+    EnginePool::set_capacity(int(long(PL_A1)));
+    return TRUE;
+}
+
 /** getOpenFileName(+Title, ?StartPath, +Pattern, -Choice)
  *  run a modal dialog on request from foreign thread
  *  this must run a modal loop in GUI thread
@@ -29,6 +29,9 @@
 #include <QMetaObject>
 #include <QMetaProperty>
 #include <QMutex>
+#include <QHash>
+#include <QAtomicInt>
+#include <QReadWriteLock>
 
 /*!
   \mainpage
@@ -64,9 +67,15 @@ public:
     static void addConsole(ConsoleEdit*);
     static void removeConsole(ConsoleEdit*);
 
-    /** search widgets hierarchy looking for the first */
+    /** console serving Prolog thread id, lock free when unchanged since last call in thread */
     static ConsoleEdit *by_thread();
 
+    /** maintain the thread id -> console map used by by_thread()
+     *  bind returns the previous owner, to be restored by unbind
+     */
+    static ConsoleEdit *bind_thread(int thid, ConsoleEdit *c);
+    static void unbind_thread(int thid, ConsoleEdit *c, ConsoleEdit *previous = 0);
+
     /** search widgets hierarchy looking for any ConsoleEdit */
     static ConsoleEdit *peek_first();
 
@@ -79,12 +88,17 @@ public:
     /** run in GUI thread */
     static void gui_run(pfunc f);
 
-    /** saving history lines on exit is messed by PL_halt...*/
-    static QStringList last_history_lines;
+    /** run all in a single GUI thread turn, in order */
+    static void gui_run(QList<pfunc> fs);
 
 private:
     static QList<ConsoleEdit*> consoles;
     static QMutex consoles_sync;
+
+    /** read mostly map, each change bumps generation to invalidate threads cache */
+    static QHash<int, ConsoleEdit*> thread_consoles;
+    static QReadWriteLock thread_consoles_sync;
+    static QAtomicInt thread_consoles_generation;
 };
 
 #endif // PQCONSOLE_H
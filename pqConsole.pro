@@ -24,6 +24,8 @@ DEFINES += PL_SAFE_ARG_MACROS
 SOURCES += \
     pqConsole.cpp \
     SwiPrologEngine.cpp \
+    SwiPrologEngine_core.cpp \
+    Swipl_Streams.cpp \
     ConsoleEdit.cpp \
     pqTerm.cpp \
     Completion.cpp \
@@ -34,12 +36,30 @@ SOURCES += \
     pqApplication.cpp \
     win_builtins.cpp \
     reflexive.cpp \
-    pqMiniSyntax.cpp
+    pqMiniSyntax.cpp \
+    OutputRing.cpp \
+    ScrollbackLog.cpp \
+    AnsiSgrParser.cpp \
+    InputQueue.cpp \
+    pqQuery.cpp \
+    EnginePool.cpp \
+    QueryScheduler.cpp \
+    PrefixIndex.cpp \
+    HelpIndex.cpp \
+    FuzzyMatcher.cpp \
+    RankedModel.cpp \
+    PrologLexer.cpp \
+    SpanStore.cpp \
+    SemanticColour.cpp \
+    TextIndex.cpp \
+    HistoryStore.cpp \
+    GuiPost.cpp
 
 HEADERS += \
     pqConsole.h \
     pqConsole_global.h \
     SwiPrologEngine.h \
+    Swipl_Streams.h \
     ConsoleEdit.h \
     PREDICATE.h \
     pqTerm.h \
@@ -49,7 +69,24 @@ HEADERS += \
     Preferences.h \
     FlushOutputEvents.h \
     pqApplication.h \
-    pqMiniSyntax.h
+    pqMiniSyntax.h \
+    OutputRing.h \
+    ScrollbackLog.h \
+    AnsiSgrParser.h \
+    InputQueue.h \
+    pqQuery.h \
+    EnginePool.h \
+    QueryScheduler.h \
+    PrefixIndex.h \
+    HelpIndex.h \
+    FuzzyMatcher.h \
+    RankedModel.h \
+    PrologLexer.h \
+    SpanStore.h \
+    SemanticColour.h \
+    TextIndex.h \
+    HistoryStore.h \
+    GuiPost.h
 
 symbian {
     MMP_RULES += EXPORTUNFROZEN
@@ -92,6 +129,7 @@ unix:!symbian:!macx {
     } else {
         target.path = /usr/lib
     }
+    CONFIG(pq_batch): target.path = /usr/bin
 
     INSTALLS += target
 }
@@ -118,7 +156,8 @@ OTHER_FILES += \
     README.md \
     pqConsole.doxy \
     swipl.png \
-    trace_interception.pl
+    trace_interception.pl \
+    pq_colour.pl
 
 RESOURCES += \
     pqConsole.qrc
@@ -129,3 +168,49 @@ else:unix:!symbian: LIBS += -L$$OUT_PWD/../lqUty/ -llqUty
 
 INCLUDEPATH += $$PWD/../lqUty
 DEPENDPATH += $$PWD/../lqUty
+
+# headless batch runner: qmake CONFIG+=pq_batch
+# a console application on QtCore, only the engine and query sources are linked
+CONFIG(pq_batch) {
+    TARGET = pqBatch
+    TEMPLATE = app
+    QT -= gui widgets
+    CONFIG += console
+    CONFIG -= app_bundle
+    DEFINES -= PQCONSOLE_LIBRARY
+    DEFINES += PQCONSOLE_STATIC
+    SOURCES = \
+        pqBatch.cpp \
+        SwiPrologEngine_core.cpp \
+        Swipl_Streams.cpp \
+        pqTerm.cpp \
+        pqQuery.cpp \
+        EnginePool.cpp \
+        QueryScheduler.cpp
+    HEADERS = \
+        pqConsole_global.h \
+        PREDICATE.h \
+        Swipl_Streams.h \
+        pqTerm.h \
+        pqQuery.h \
+        EnginePool.h \
+        QueryScheduler.h
+    RESOURCES =
+}
+
+# lexer benchmark: qmake CONFIG+=pq_bench
+# only QtCore and the lexer are needed, the QRegExp scanner is in pqBench.cpp
+CONFIG(pq_bench) {
+    TARGET = pqBench
+    TEMPLATE = app
+    QT -= gui widgets
+    CONFIG += console
+    CONFIG -= app_bundle
+    DEFINES -= PQCONSOLE_LIBRARY
+    DEFINES += PQCONSOLE_STATIC
+    SOURCES = pqBench.cpp PrologLexer.cpp
+    HEADERS = PrologLexer.h
+    RESOURCES =
+    LIBS =
+    PKGCONFIG -= swipl
+}
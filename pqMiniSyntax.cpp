@@ -21,96 +21,380 @@
 */
 
 #include "pqMiniSyntax.h"
-#include "do_events.h"
+#include "GuiPost.h"
 #include <QTextDocument>
 #include <QDebug>
 #include <QTime>
+#include <QThreadPool>
+#include <QScrollBar>
 
 /** this is a very limited approach to highlighting Prolog syntax.
   * Just a quick alternative to properly interfacing SWI-Prolog goodies,
   * that proved to be a much harder task than I foreseen
   */
 void pqMiniSyntax::setup() {
-    QString number("\\d+(?:\\.\\d+)?");
-    QString symbol("[a-z][A-Za-z0-9_]*");
-    QString var("[A-Z_][A-Za-z0-9_]*");
-    QString quoted("\"[^\"]*\"");
-    QString atomq("'[^\'']*'");
-    QString atombackq("`[^`]*`");
-    QString charcode("0'.|0'\\t|0'\\n|0'\\r|0'\\u[0-9][0-9][0-9][0-9]");
-    QString oper("[\\+\\-\\*\\/\\=\\^<>~:\\.,;\\?@#$\\\\&{}`]+");
-
-    tokens = QRegExp(QString("(%1)|(%2)|(%3)|(%4)|(%5)|(%6)|(%7)|(%8)|%").arg(number, symbol, var, quoted, atomq, atombackq, charcode, oper));
-
-    fmt[Comment].setForeground(Qt::darkGreen);
-    fmt[Number].setForeground(QColor("blueviolet"));
-    fmt[Atom].setForeground(Qt::blue);
-    fmt[Atomq].setForeground(Qt::blue);
-    fmt[Atombackq].setForeground(Qt::darkYellow);
-    fmt[String].setForeground(Qt::magenta);
-    fmt[Variable].setForeground(QColor("brown"));
-    fmt[Operator].setFontWeight(QFont::Bold);
-    fmt[CharCode].setForeground(Qt::darkCyan);
-    fmt[Unknown].setForeground(Qt::darkRed);
+    typedef PrologLexer L;
+
+    store = QSharedPointer<SpanStore>(new SpanStore);
+    lex_blocks = -1;
+    view_first = 0;
+    view_last = -1;
+    chain = chain_next = 0;
+    filling = -1;
+    fill_next = fill_limit = 0;
+    colour_revision = -1;
+
+    lex_timer.setSingleShot(true);
+    lex_timer.setInterval(50);
+    connect(&lex_timer, SIGNAL(timeout()), SLOT(lex_start()));
+    connect(&fill_timer, SIGNAL(timeout()), SLOT(fill()));
+
+    colour_timer.setSingleShot(true);
+    colour_timer.setInterval(500);
+    connect(&colour_timer, SIGNAL(timeout()), SLOT(colour_start()));
+
+    if (auto a = qobject_cast<QAbstractScrollArea*>(view))
+        connect(a->verticalScrollBar(), SIGNAL(valueChanged(int)), SLOT(view_scrolled()));
+    view_changed();
+
+    fmt[L::Comment].setForeground(Qt::darkGreen);
+    fmt[L::Number].setForeground(QColor("blueviolet"));
+    fmt[L::Atom].setForeground(Qt::blue);
+    fmt[L::Atomq].setForeground(Qt::blue);
+    fmt[L::Atombackq].setForeground(Qt::darkYellow);
+    fmt[L::String].setForeground(Qt::magenta);
+    fmt[L::Variable].setForeground(QColor("brown"));
+    fmt[L::Operator].setFontWeight(QFont::Bold);
+    fmt[L::CharCode].setForeground(Qt::darkCyan);
+    fmt[L::Unknown].setForeground(Qt::darkRed);
+
+    if (large())
+        lex_timer.start();
+}
+
+int pqMiniSyntax::sync_blocks = 2000;
+
+/** semantic fragments, block relative, from clauses overlapping block
+ *  text is the block content when set, fragments apply only while it matches
+ */
+struct block_colours : QTextBlockUserData {
+    QString text;
+    SemanticColour::fragments fragments;
+};
+
+/** after a full pass started, only these blocks (plus visible ones) are highlighted in place */
+static const int chain_limit = 200;
+
+/** blocks checked by each fill() slice */
+static const int fill_slice = 500;
+
+/** lines published per chunk by worker */
+static const int lex_chunk = 5000;
+
+bool pqMiniSyntax::large() const {
+    return document() && document()->blockCount() > sync_blocks;
+}
+
+/** generation of worker states, if still valid for current document
+ */
+int pqMiniSyntax::snapshot() const {
+    return document() && document()->blockCount() == lex_blocks ? store->generation.loadAcquire() : -1;
+}
+
+/** lex a copy of document lines, publishing entry states and results in chunks
+ *  staleness is checked on the shared store, that outlives the highlighter
+ */
+class lex_job : public QRunnable {
+public:
+    lex_job(pqMiniSyntax *syntax, QSharedPointer<SpanStore> store, int generation, QStringList lines)
+        : syntax(syntax), store(store), generation(generation), lines(lines) {}
+
+    virtual void run() {
+        int state = 0;
+        for (int first = 0; first < lines.size(); first += lex_chunk) {
+            // superseded by a newer snapshot
+            if (generation != store->generation.loadAcquire())
+                return;
+
+            int last = qMin(lines.size(), first + lex_chunk);
+            QVector<int> states;
+            states.reserve(last - first);
+            for (int i = first; i < last; ++i) {
+                states.append(state);
+                state = store->lex(lines[i], state).state_out;
+            }
+            store->set_states(generation, first, states);
+
+            // syntax is tested in GUI thread only
+            QPointer<pqMiniSyntax> s = syntax;
+            int g = generation;
+            GuiPost::post([s, g, last]() {
+                if (s)
+                    s->lexed(g, last);
+            });
+        }
+    }
+
+private:
+    QPointer<pqMiniSyntax> syntax;
+    QSharedPointer<SpanStore> store;
+    int generation;
+    QStringList lines;
+};
+
+void pqMiniSyntax::lex_start() {
+    if (!document())
+        return;
+
+    QStringList lines;
+    for (QTextBlock b = document()->begin(); b.isValid(); b = b.next())
+        lines.append(b.text());
+
+    // drop results of lines long gone
+    if (store->size() > 4 * lines.size() + 1000)
+        store->clear();
+
+    lex_blocks = lines.size();
+    int g = store->generation.fetchAndAddOrdered(1) + 1;
+    fill_limit = 0;
+    QThreadPool::globalInstance()->start(new lex_job(this, store, g, lines));
+}
+
+void pqMiniSyntax::lexed(int generation, int upto) {
+    if (generation != snapshot())
+        return;
+    fill_limit = upto;
+    if (!fill_timer.isActive())
+        fill_timer.start();
+}
+
+/** rehighlight visible blocks, then a slice of the others, where not current with worker states
+ */
+void pqMiniSyntax::fill() {
+    int g = snapshot();
+    if (g < 0) {
+        fill_timer.stop();
+        lex_timer.start();
+        return;
+    }
+
+    view_changed();
+
+    auto update = [&](QTextBlock b) {
+        int n = b.blockNumber();
+        if (n >= fill_limit)
+            return;
+        int s = b.userState();
+        if (s == pending || state_in(s) != store->state_at(g, n)) {
+            filling = n;
+            rehighlightBlock(b);
+            filling = -1;
+        }
+    };
+
+    QTextBlock b = document()->findBlockByNumber(view_first);
+    for ( ; b.isValid() && b.blockNumber() <= view_last; b = b.next())
+        update(b);
+
+    int n = 0;
+    for (b = document()->findBlockByNumber(fill_next); b.isValid() && b.blockNumber() < fill_limit && n < fill_slice; b = b.next(), ++n)
+        update(b);
+    fill_next = b.isValid() ? b.blockNumber() : document()->blockCount();
+
+    if (fill_next >= fill_limit) {
+        fill_timer.stop();
+        if (fill_next == document()->blockCount())
+            qDebug() << "filled at " << QTime::currentTime() << "in" << startToEnd.elapsed();
+    }
+}
+
+void pqMiniSyntax::view_changed() {
+    QTextCursor top, bottom;
+    if (auto e = qobject_cast<QTextEdit*>(view)) {
+        top = e->cursorForPosition(QPoint(0, 0));
+        bottom = e->cursorForPosition(QPoint(e->viewport()->width(), e->viewport()->height()));
+    }
+    else if (auto e = qobject_cast<QPlainTextEdit*>(view)) {
+        top = e->cursorForPosition(QPoint(0, 0));
+        bottom = e->cursorForPosition(QPoint(e->viewport()->width(), e->viewport()->height()));
+    }
+    else
+        return;
+
+    view_first = top.blockNumber();
+    view_last = bottom.blockNumber();
+}
+
+void pqMiniSyntax::view_scrolled() {
+    view_changed();
+    if (large() && view_first < fill_limit && !fill_timer.isActive())
+        fill_timer.start();
 }
 
 /** handle nested comments and simple minded Prolog syntax
+  * lexing is done by PrologLexer, see there for state encoding.
+  * On large documents, only visible blocks and the start of each pass are done here,
+  * others are left pending (or with previous formats) to be refreshed by fill()
   */
 void pqMiniSyntax::highlightBlock(const QString &text)
 {
-    // simple state machine
     int nb = currentBlock().blockNumber();
-    if (nb > 0) {
-        setCurrentBlockState(previousBlockState());
-        if (nb % 10 == 0)
-            do_events();
-    }
-    else {
+    if (nb == 0) {
         startToEnd.start();
         qDebug() << "starting at " << QTime::currentTime();
-        setCurrentBlockState(0);
     }
 
-    for (int i = 0, j, l; ; i = j + l)
-        if (currentBlockState()) {  // in multiline comment
-            if ((j = text.indexOf("*/", i)) == -1) {
-                setFormat(i, text.length() - i, fmt[Comment]);
-                break;
-            }
-            setFormat(i, j - i + (l = 2), fmt[Comment]);
-            setCurrentBlockState(0);
-        } else {
-            if ((j = tokens.indexIn(text, i)) == -1)
-                break;
-            QStringList ml = tokens.capturedTexts();
-            Q_ASSERT(ml.length() == 8+1);
-            if ((l = ml[1].length())) {  // number
-                setFormat(j, l, fmt[Number]); } else
-            if ((l = ml[2].length())) {  // symbol
-                setFormat(j, l, fmt[Atom]); } else
-            if ((l = ml[3].length())) {  // var
-                setFormat(j, l, fmt[Variable]); } else
-            if ((l = ml[4].length())) {  // double quoted string
-                setFormat(j, l, fmt[String]); } else
-            if ((l = ml[5].length())) {  // quoted atom
-                setFormat(j, l, fmt[Atomq]); } else
-            if ((l = ml[6].length())) {  // quoted atom
-                setFormat(j, l, fmt[Atombackq]); } else
-            if ((l = ml[7].length())) {  // char code
-                setFormat(j, l, fmt[CharCode]); } else
-            if ((l = ml[8].length())) {  // operator
-                // or comment ?
-                if (l >= 2 && ml[8].left(2) == "/*") {
-                    setFormat(j, l = 2, fmt[Comment]);
-                    setCurrentBlockState(1);
-                } else
-                    setFormat(j, l, fmt[Operator]); } else
-            {   // single line comment
-                setFormat(j, text.length() - i, fmt[Comment]);
-                break;
+    if (nb != chain_next)
+        chain = 0;
+    chain_next = nb + 1;
+    ++chain;
+
+    int g = snapshot();
+    int prev = previousBlockState();
+    int in = prev == pending ? store->state_at(g, nb) : state_out(prev);
+
+    bool eager = !large() || nb == filling || (nb >= view_first && nb <= view_last) || chain <= chain_limit;
+    if (in < 0 || !eager) {
+        // keep previous state, to stop propagation: fill() will check it
+        int old = currentBlockState();
+        setCurrentBlockState(old == -1 || in < 0 ? pending : old);
+        if (in < 0 || in != store->state_at(g, nb))
+            lex_timer.start();
+        else if (!fill_timer.isActive())
+            fill_timer.start();
+        fill_next = qMin(fill_next, nb);
+        return;
+    }
+
+    SpanStore::line l = store->lex(text, in);
+    foreach (quint64 s, l.spans)
+        setFormat(SpanStore::span_start(s), SpanStore::span_length(s), fmt[SpanStore::span_token(s)]);
+    setCurrentBlockState(in << 16 | (l.state_out & 0xFFFF));
+
+    // semantic fragments, if still matching text
+    auto d = static_cast<block_colours*>(currentBlockUserData());
+    if (d && d->text == text)
+        foreach (SemanticColour::fragment f, d->fragments) {
+            const QTextCharFormat &c = class_format(f.cls);
+            if (c.propertyCount()) {
+                QTextCharFormat m = format(f.start);
+                m.merge(c);
+                setFormat(f.start, f.length, m);
             }
         }
 
     if (currentBlock() == document()->lastBlock())
         qDebug() << "done at " << QTime::currentTime() << "in" << startToEnd.elapsed();
 }
+
+void pqMiniSyntax::setSemantic(QString source) {
+    semantic_source = source;
+    if (!semantic) {
+        semantic = QSharedPointer<SemanticColour>(new SemanticColour);
+        if (document())
+            connect(document(), SIGNAL(contentsChanged()), &colour_timer, SLOT(start()));
+    }
+    colour_revision = -1;
+    colour_timer.start();
+}
+
+const QTextCharFormat &pqMiniSyntax::class_format(int cls) {
+    while (class_fmt.size() <= cls)
+        class_fmt.append(SemanticColour::formats().value(SemanticColour::class_name(class_fmt.size())));
+    return class_fmt[cls];
+}
+
+/** split and colourise a copy of document text, on a pooled engine
+ */
+class colour_job : public QRunnable {
+public:
+    colour_job(pqMiniSyntax *syntax, QSharedPointer<SemanticColour> semantic, int generation, int revision, QString text, QString source)
+        : syntax(syntax), semantic(semantic), generation(generation), revision(revision), text(text), source(source) {}
+
+    virtual void run() {
+        if (generation != semantic->generation.loadAcquire())
+            return;
+
+        SemanticColour::clauses cl = SemanticColour::split(text);
+        semantic->colourise(text, cl, source);
+        semantic->set_pass(generation, cl);
+
+        // syntax is tested in GUI thread only
+        QPointer<pqMiniSyntax> s = syntax;
+        int g = generation, r = revision;
+        GuiPost::post([s, g, r]() {
+            if (s)
+                s->coloured(g, r);
+        });
+    }
+
+private:
+    QPointer<pqMiniSyntax> syntax;
+    QSharedPointer<SemanticColour> semantic;
+    int generation, revision;
+    QString text, source;
+};
+
+void pqMiniSyntax::colour_start() {
+    if (!semantic || !document() || document()->revision() == colour_revision)
+        return;
+
+    // drop results of clauses long gone
+    if (semantic->size() > 4 * document()->blockCount() + 1000)
+        semantic->clear();
+
+    int g = semantic->generation.fetchAndAddOrdered(1) + 1;
+    QThreadPool::globalInstance()->start(new colour_job(this, semantic, g, document()->revision(), document()->toPlainText(), semantic_source));
+}
+
+/** attach fragments to blocks, and rehighlight blocks where they changed
+ */
+void pqMiniSyntax::coloured(int generation, int revision) {
+    if (!semantic || generation != semantic->generation.loadAcquire())
+        return;
+    if (revision != document()->revision()) {
+        colour_timer.start();
+        return;
+    }
+    colour_revision = revision;
+
+    SemanticColour::clauses cl = semantic->pass(generation);
+    int k = 0, n = cl.size();
+
+    for (QTextBlock b = document()->begin(); b.isValid(); b = b.next()) {
+        int p = b.position(), e = p + b.length() - 1;
+        while (k < n && cl[k].start + cl[k].length <= p)
+            ++k;
+
+        SemanticColour::fragments bf;
+        for (int j = k; j < n && cl[j].start < e; ++j) {
+            SemanticColour::fragments f;
+            if (!semantic->find(cl[j].text, f))
+                continue;
+            foreach (SemanticColour::fragment x, f) {
+                int s = qMax(cl[j].start + x.start, p) - p, t = qMin(cl[j].start + x.start + x.length, e) - p;
+                if (s < t) {
+                    SemanticColour::fragment y = { s, t - s, x.cls };
+                    bf.append(y);
+                }
+            }
+        }
+
+        auto d = static_cast<block_colours*>(b.userData());
+        if (bf.isEmpty() ? !d : d && d->text == b.text() && d->fragments == bf)
+            continue;
+
+        if (bf.isEmpty())
+            b.setUserData(0);
+        else {
+            d = new block_colours;
+            d->text = b.text();
+            d->fragments = bf;
+            b.setUserData(d);
+        }
+
+        filling = b.blockNumber();
+        rehighlightBlock(b);
+        filling = -1;
+    }
+}
@@ -25,11 +25,19 @@
 
 #include "pqConsole_global.h"
 #include <QSyntaxHighlighter>
-#include <QRegExp>
 #include <QElapsedTimer>
 #include <QPlainTextEdit>
+#include <QTextEdit>
+#include <QPointer>
+#include <QAtomicInt>
+#include <QTimer>
+#include <QSharedPointer>
+#include "SpanStore.h"
+#include "SemanticColour.h"
 
 /** a minimal Prolog syntax highlighter
+ *  large documents are lexed on a worker into a SpanStore,
+ *  then formats are applied to visible blocks first, and to the rest progressively
  */
 class PQCONSOLESHARED_EXPORT pqMiniSyntax : public QSyntaxHighlighter
 {
@@ -38,34 +46,82 @@ public:
 
     pqMiniSyntax(QObject *parent = 0) : QSyntaxHighlighter(parent) { setup(); }
     pqMiniSyntax(QTextDocument *parent) : QSyntaxHighlighter(parent) { setup(); }
-    pqMiniSyntax(QTextEdit *parent)  : QSyntaxHighlighter(parent) { setup(); }
-    pqMiniSyntax(QPlainTextEdit *parent)  : QSyntaxHighlighter(parent) { setup(); }
+    pqMiniSyntax(QTextEdit *parent)  : QSyntaxHighlighter(parent), view(parent) { setup(); }
+    pqMiniSyntax(QPlainTextEdit *parent)  : QSyntaxHighlighter(parent), view(parent) { setup(); }
+
+    /** documents up to these blocks are highlighted synchronously */
+    static int sync_blocks;
+
+    /** add colouring from prolog_colourise_term, with cross reference of source file */
+    void setSemantic(QString source);
 
 signals:
 
 public slots:
 
+    /** worker published lines [0, upto) of snapshot <generation> */
+    void lexed(int generation, int upto);
+
+    /** worker colourised snapshot <generation>, taken at document <revision> */
+    void coloured(int generation, int revision);
+
 protected:
 
     // handle state tracking using currentBlockState/previousBlockState
     virtual void highlightBlock(const QString &text);
 
+private slots:
+
+    /** snapshot document text and start the worker */
+    void lex_start();
+
+    /** apply a slice of results, visible blocks first */
+    void fill();
+
+    /** visible blocks changed, serve them first */
+    void view_scrolled();
+
+    /** snapshot document text and start semantic colouring */
+    void colour_start();
+
 private:
 
-    enum token_name {
-        Comment,
-        Atom,
-        Atomq,
-        Atombackq,
-        String,
-        Variable,
-        Number,
-        Operator,
-        CharCode,
-        Unknown
-    };
-    QTextCharFormat fmt[Unknown+1];
-    QRegExp tokens;
+    typedef PrologLexer::token token_name;
+    QTextCharFormat fmt[PrologLexer::Unknown+1];
+
+    /** block state is state_in << 16 | state_out, or pending while waiting for worker */
+    enum { pending = -2 };
+    static int state_in(int s) { return s < 0 ? s : s >> 16; }
+    static int state_out(int s) { return s < 0 ? 0 : s & 0xFFFF; }
+
+    /** shared with worker, that can outlive this */
+    QSharedPointer<SpanStore> store;
+
+    /** snapshot block count: when changed, worker states are stale */
+    int lex_blocks;
+    int snapshot() const;
+
+    /** cache visible blocks range */
+    QPointer<QWidget> view;
+    int view_first, view_last;
+    void view_changed();
+
+    /** consecutive blocks highlighted in a pass, beyond the first ones are deferred */
+    int chain, chain_next;
+    int filling;
+
+    QTimer lex_timer, fill_timer;
+    int fill_next, fill_limit;
+
+    /** semantic layer: per clause cache, and per block fragments in user data */
+    QSharedPointer<SemanticColour> semantic;
+    QString semantic_source;
+    QTimer colour_timer;
+    int colour_revision;
+    QVector<QTextCharFormat> class_fmt;
+    const QTextCharFormat &class_format(int cls);
+
+    bool large() const;
 
     void setup();
     QElapsedTimer startToEnd;
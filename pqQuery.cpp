@@ -0,0 +1,270 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#define PROLOG_MODULE "pqConsole"
+#include "pqQuery.h"
+#include "pqTerm.h"
+#include "PREDICATE.h"
+#include "SwiPrologEngine.h"
+#include <QMetaMethod>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QMutex>
+#include <QHash>
+#include <QDebug>
+
+/** serial of query running in each Prolog thread */
+static QMutex running_sync;
+static QHash<int, quint64> running;
+static quint64 last_serial;
+
+pqQuery::pqQuery(QString goal, QString module, int batch_size, int limit)
+    : goal_(goal),
+      module_(module.isEmpty() ? "user" : module),
+      batch_size_(qMax(1, batch_size)),
+      limit_(limit),
+      count_(0),
+      state_(queued),
+      wall_ms_(0),
+      cpu_time_(0),
+      inferences_(0),
+      thread_id(-1),
+      serial(0)
+{
+}
+
+/** pq_query_cancel(+Serial)
+ *  run by thread_signal/2 from pqQuery::cancel, throw only if that query still runs
+ */
+PREDICATE(pq_query_cancel, 1) {
+    quint64 s = quint64(long(PL_A1));
+    {   QMutexLocker lk(&running_sync);
+        if (running.value(PL_thread_self()) != s)
+            return TRUE;
+    }
+    throw PlException(A("pq_query_cancelled"));
+}
+
+predicate2(thread_signal)
+
+bool pqQuery::cancel() {
+    if (state_.testAndSetOrdered(queued, cancelled)) {
+        emit exception("cancelled");
+        return true;
+    }
+    if (state_.loadAcquire() == running) {
+        int thid;
+        quint64 s;
+        {   QMutexLocker lk(&running_sync);
+            thid = thread_id;
+            s = serial;
+        }
+        try {
+            SwiPrologEngine::in_thread _e;
+            return thread_signal(long(thid), PlCompound(":", V(A("pqConsole"), PlCompound("pq_query_cancel", V(long(s))))));
+        }
+        catch(PlException ex) {
+            qDebug() << "pqQuery::cancel" << t2w(ex);
+        }
+    }
+    return false;
+}
+
+predicate2(current_prolog_flag)
+predicate2(set_prolog_flag)
+predicate2(statistics)
+
+/** thread CPU seconds */
+static double thread_cputime() {
+    PlTerm t;
+    return statistics(A("cputime"), t) ? double(t) : 0;
+}
+
+/** thread inferences */
+static long thread_inferences() {
+    PlTerm t;
+    return statistics(A("inferences"), t) ? long(t) : 0;
+}
+
+/** stack_limit flag of the thread, restored on any exit from the query
+ */
+struct stack_bound {
+    stack_bound(qint64 bytes) : set(false) {
+        if (bytes && current_prolog_flag(A("stack_limit"), old_limit))
+            set = set_prolog_flag(A("stack_limit"), PlTerm(long(bytes)));
+    }
+    ~stack_bound() {
+        if (set)
+            try { set_prolog_flag(A("stack_limit"), old_limit); }
+            catch(PlException) {}
+    }
+    PlTerm old_limit;
+    bool set;
+};
+
+/** run in current Prolog thread, unless cancelled while queued
+ *  the thread and serial are published with the running state, for cancel()
+ */
+void pqQuery::run() {
+    {   QMutexLocker lk(&running_sync);
+        if (!state_.testAndSetOrdered(queued, running))
+            return;
+        thread_id = PL_thread_self();
+        serial = ++last_serial;
+        running[thread_id] = serial;
+    }
+
+    PlFrame fr;
+    QString error;
+    QElapsedTimer wall;
+    try {
+        stack_bound stack(bounds_.stack_bytes);
+        double cpu0 = thread_cputime();
+        long inf0 = thread_inferences();
+        wall.start();
+
+        error = solve();
+
+        wall_ms_ = wall.elapsed();
+        cpu_time_ = thread_cputime() - cpu0;
+        inferences_ = thread_inferences() - inf0;
+    }
+    catch(PlException ex) {
+        qDebug() << "pqQuery::run" << t2w(ex);
+        if (error.isNull())
+            error = t2w(ex);
+    }
+
+    {   QMutexLocker lk(&running_sync);
+        running.remove(thread_id);
+    }
+    state_.testAndSetOrdered(running, finished);
+
+    if (error.isNull())
+        emit completed(count_);
+    else
+        emit exception(error);
+}
+
+predicate3(atom_to_term)
+structure3(call_with_inference_limit)
+predicate3(alarm)
+predicate1(remove_alarm)
+
+/** wall clock deadline, as a library(time) alarm throwing time_limit_exceeded
+ *  in the running thread. Unlike call_with_time_limit/2 this doesn't commit
+ *  to the first solution: the alarm stays armed while solutions are enumerated,
+ *  and it's removed when the query is left (exit, failure, exception or limit)
+ */
+struct time_alarm {
+    time_alarm(int ms) : armed(false) {
+        if (ms)
+            armed = alarm(PlTerm(ms / 1000.0), PlCompound("throw", V(A("time_limit_exceeded"))), id);
+    }
+    ~time_alarm() {
+        if (armed)
+            try { remove_alarm(id); }
+            catch(PlException) {}
+    }
+    PlTerm id;
+    bool armed;
+};
+
+/** variable names come from parsing the goal text, as the toplevel does,
+ *  don't care variables (starting with _) are not reported
+ *  return the error message, or a null string when completed
+ */
+QString pqQuery::solve() {
+    bool bindings = isSignalConnected(QMetaMethod::fromSignal(&pqQuery::solutions));
+    try {
+        PlTerm Goal, Bindings, B;
+        if (!atom_to_term(W(goal_), Goal, Bindings))
+            return tr("cannot parse %1").arg(goal_);
+
+        QList<QPair<QString, PlTerm>> vars;
+        if (bindings)
+            for (PlTail l(Bindings); l.next(B); ) {
+                QString name = t2w(B[1]);
+                if (!name.startsWith('_'))
+                    vars.append(qMakePair(name, B[2]));
+            }
+
+        // wrap with requested bounds, innermost is inference count
+        PlTerm Bounded = Goal, Result;
+        if (bounds_.inferences)
+            Bounded = call_with_inference_limit(Bounded, long(bounds_.inferences), Result);
+
+        QVariantList batch;
+        time_alarm deadline(bounds_.timeout_ms);
+        PlQuery q(A(module_), "call", V(Bounded));
+
+        // deliver solutions found before a timeout or cancel
+        auto next = [&]() {
+            try {
+                return q.next_solution();
+            }
+            catch(PlException) {
+                if (!batch.isEmpty())
+                    emit solutions(batch);
+                throw;
+            }
+        };
+        while ((!limit_ || count_ < limit_) && next()) {
+            if (bounds_.inferences && Result == "inference_limit_exceeded") {
+                if (!batch.isEmpty())
+                    emit solutions(batch);
+                return "inference_limit_exceeded";
+            }
+            ++count_;
+            emit solved(count_);
+            if (bindings) {
+                QVariantMap s;
+                foreach (auto v, vars)
+                    s[v.first] = term2variant(v.second);
+                batch.append(s);
+                if (batch.size() >= batch_size_) {
+                    emit solutions(batch);
+                    batch.clear();
+                }
+            }
+        }
+        if (!batch.isEmpty())
+            emit solutions(batch);
+
+        return QString();
+    }
+    catch(PlException ex) {
+        QString detail = t2w(ex);
+        if (detail == "pq_query_cancelled") {
+            state_.storeRelease(cancelled);
+            return "cancelled";
+        }
+        if (detail == "time_limit_exceeded")
+            return detail;
+        QString message = QString::fromWCharArray(WCP(ex));
+        qDebug() << "PlException" << CT << module_ << goal_ << detail << message;
+        return QString("[%1]\n[%2]").arg(message, detail);
+    }
+    catch(QString s) {
+        return s;
+    }
+}
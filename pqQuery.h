@@ -0,0 +1,125 @@
+/*
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef PQQUERY_H
+#define PQQUERY_H
+
+#include "pqConsole_global.h"
+#include <QObject>
+#include <QVariant>
+#include <QAtomicInt>
+#include <QSharedPointer>
+
+/** a query whose solutions are delivered asynchronously
+ *  Each solution is a QVariantMap from variable name to value
+ *  (see term2variant), solutions are grouped in batches to avoid a
+ *  signal per solution. Signals are emitted in the running Prolog thread,
+ *  so receivers in GUI get them queued.
+ */
+class PQCONSOLESHARED_EXPORT pqQuery : public QObject {
+    Q_OBJECT
+public:
+
+    /** build query of <goal> text, to be run in <module> (default user) */
+    pqQuery(QString goal, QString module = QString(), int batch_size = 100, int limit = 0);
+
+    /** the goal, as text */
+    QString goal() const { return goal_; }
+
+    /** context module */
+    QString module() const { return module_; }
+
+    /** solutions delivered together */
+    int batch_size() const { return batch_size_; }
+
+    /** stop after this many solutions (0 = all) */
+    int limit() const { return limit_; }
+
+    /** solutions delivered so far */
+    int count() const { return count_; }
+
+    /** resources used by last run, valid when completed or exception are emitted */
+    qint64 wall_ms() const { return wall_ms_; }
+    double cpu_time() const { return cpu_time_; }
+    long inferences() const { return inferences_; }
+
+    /** optional resource bounds, 0 means unbounded */
+    struct limits {
+        limits(int timeout_ms = 0, long inferences = 0, qint64 stack_bytes = 0) :
+            timeout_ms(timeout_ms), inferences(inferences), stack_bytes(stack_bytes) {}
+        int timeout_ms;     // wall clock, by alarm/3 (keeps nondeterminism)
+        long inferences;    // by call_with_inference_limit/3
+        qint64 stack_bytes; // stack_limit flag, while the query runs
+    };
+    const limits& bounds() const { return bounds_; }
+    void set_bounds(const limits &l) { bounds_ = l; }
+
+    /** life cycle */
+    enum state_t { queued, running, finished, cancelled };
+    state_t state() const { return state_t(state_.loadAcquire()); }
+
+    /** if queued, will be skipped, if running raise pq_query_cancelled in its thread
+     *  in both cases exception("cancelled") is reported
+     */
+    bool cancel();
+
+    /** run in current Prolog thread, emitting batches */
+    void run();
+
+signals:
+
+    /** a batch of solutions, each a QVariantMap Name -> Value */
+    void solutions(QVariantList batch);
+
+    /** a solution was found, bindings computed only if solutions() is connected */
+    void solved(int count);
+
+    /** no more solutions */
+    void completed(int count);
+
+    /** goal raised exception (or syntax error, or limit exceeded, or cancelled) */
+    void exception(QString message);
+
+private:
+
+    QString goal_, module_;
+    int batch_size_, limit_;
+    int count_;
+    limits bounds_;
+
+    QAtomicInt state_;
+
+    qint64 wall_ms_;
+    double cpu_time_;
+    long inferences_;
+
+    /** identify the run, to target cancel signal */
+    int thread_id;
+    quint64 serial;
+
+    QString solve();
+};
+
+/** handle shared by caller and executing queue */
+typedef QSharedPointer<pqQuery> pqQueryPtr;
+
+#endif // PQQUERY_H
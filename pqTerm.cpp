@@ -38,7 +38,15 @@ QVariant term2variant(PlTerm t) {
         return t2w(t);
 
     default:
-        throw QObject::tr("term2variant: unknown type %1").arg(t.type());
+        if (PL_is_pair(t)) {
+            QVariantList l;
+            PlTerm e;
+            for (PlTail t_(t); t_.next(e); )
+                l.append(term2variant(e));
+            return l;
+        }
+        // compounds, [], blobs: keep a readable representation
+        return serialize(t);
     }
 }
 
@@ -0,0 +1,80 @@
+/*  File         : pq_colour.pl
+    Purpose      : collect prolog_colour fragments for highlighting
+
+    pqConsole    : interfacing SWI-Prolog and Qt
+
+    Author       : Carlo Capelli
+    E-mail       : cc.carlo.cap@gmail.com
+    Copyright (C): 2013,2014 Carlo Capelli
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+:- module(pq_colour, [pq_colour_prepare/2, pq_colour_clause/3, pq_colour_query/2]).
+:- use_module(library(prolog_colour)).
+:- use_module(library(prolog_xref)).
+
+%%  pq_colour_prepare(+Source, -Stamp) is det
+%
+%   refresh cross reference data when Source is a file,
+%   Stamp is the time xref data was last built (0 when none)
+%
+pq_colour_prepare(Source, Stamp) :-
+    (   exists_file(Source)
+    ->  catch(xref_source(Source, [silent(true)]), _, true)
+    ;   true
+    ),
+    (   xref_done(Source, Stamp)
+    ->  true
+    ;   Stamp = 0
+    ).
+
+%%  pq_colour_clause(+Text, +Source, -Fragments) is det
+%
+%   Fragments is a list of f(Start, Length, Class) for the first term in Text,
+%   Start relative to Text, Class an atom like head_exported or goal_built_in
+%
+pq_colour_clause(Text, Source, Fragments) :-
+    Acc = acc([]),
+    setup_call_cleanup(
+        open_string(Text, S),
+        catch(prolog_colourise_term(S, Source, collect(Acc), []), _, true),
+        close(S)),
+    arg(1, Acc, Rev),
+    reverse(Rev, Fragments).
+
+%%  pq_colour_query(+Text, -Fragments) is det
+%
+%   as above, for a toplevel query
+%
+pq_colour_query(Text, Fragments) :-
+    Acc = acc([]),
+    catch(prolog_colourise_query(Text, user, collect(Acc)), _, true),
+    arg(1, Acc, Rev),
+    reverse(Rev, Fragments).
+
+collect(Acc, Class, Start, Length) :-
+    class_name(Class, Name),
+    arg(1, Acc, L),
+    nb_setarg(1, Acc, [f(Start, Length, Name)|L]).
+
+class_name(Class, Name) :-
+    compound(Class),
+    Class =.. [F, Type|_],
+    memberchk(F, [goal, head]), !,
+    functor(Type, N, _),
+    atomic_list_concat([F, N], '_', Name).
+class_name(Class, Name) :-
+    functor(Class, Name, _).